@@ -0,0 +1,65 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace yaraft {
+
+// AppliedIndex publishes the applied index of the state machine from the apply
+// thread to the threads serving linearizable reads. Once a ReadState is taken
+// from Ready, the read can be served as soon as Reached(readState.index) is true,
+// or a reader can block in WaitFor, without going through the raft thread.
+//
+// All methods are thread-safe.
+class AppliedIndex {
+ public:
+  explicit AppliedIndex(uint64_t applied = 0) : applied_(applied), waiters_(0) {}
+
+  // Advance is called by the apply thread after the entries up to `index` have
+  // been applied. It never moves the applied index backwards.
+  void Advance(uint64_t index);
+
+  // The acquire load pairs with the store in Advance, so that once the index
+  // is seen, the entries applied up to it are visible too.
+  uint64_t Load() const {
+    return applied_.load(std::memory_order_acquire);
+  }
+
+  // Reached returns true if the entries up to `index` have been applied.
+  bool Reached(uint64_t index) const {
+    return Load() >= index;
+  }
+
+  // WaitFor blocks until the entries up to `index` have been applied, or until
+  // `timeout` expires. Returns whether `index` has been reached.
+  bool WaitFor(uint64_t index, std::chrono::milliseconds timeout);
+
+ private:
+  std::atomic<uint64_t> applied_;
+
+  // number of threads blocked in WaitFor, so that Advance doesn't need to take
+  // the lock when nobody waits.
+  std::atomic<int> waiters_;
+
+  std::mutex mu_;
+  std::condition_variable cond_;
+};
+
+}  // namespace yaraft
@@ -35,6 +35,10 @@ class Config {
   // rejoins the cluster.
   bool preVote;
 
+  // checkQuorum specifies if the leader should check quorum activity. Leader
+  // steps down when quorum is not active for an electionTimeout.
+  bool checkQuorum;
+
   // electionTick is the number of Node.Tick invocations that must pass between
   // elections. That is, if a follower does not receive any message from the
   // leader of current term before electionTick has elapsed, it will become
@@ -66,6 +70,37 @@ class Config {
   // used for testing right now.
   std::vector<uint64_t> peers;
 
+  // learners contains the IDs of all learner nodes (including self if the
+  // local node is a learner) in the raft cluster. Learners only receive
+  // entries from the leader; they don't vote in elections nor count in the
+  // commit quorum.
+  std::vector<uint64_t> learners;
+
+  // disableProposalForwarding set to true means that followers will drop
+  // proposals and read index requests, rather than forwarding them to the
+  // leader. One use case for this feature would be in a situation where the
+  // Raft leader is used to compute the data of a proposal, for example, adding
+  // a timestamp from a hybrid logical clock to data in a monotonically
+  // increasing way.
+  bool disableProposalForwarding;
+
+  // batchMessages set to true makes RawNode::GetReady group the outgoing
+  // messages by destination into Ready::batches instead of Ready::messages,
+  // so that each peer receives one MessageBatch per Ready.
+  bool batchMessages;
+
+  // detachSnapshots set to true makes the MsgSnaps in Ready carry only the
+  // snapshot metadata, while the images are kept in Ready::msgSnapshots and
+  // shared by all the followers a snapshot is sent to. It must only be set
+  // when Ready is sent by a Transport given Ready::msgSnapshots, which
+  // attaches the images; otherwise the followers receive empty snapshots.
+  bool detachSnapshots;
+
+  // randomSeed seeds the generator of the randomized election timeout, mixed
+  // with id so that the peers sharing a seed still time out differently. Each
+  // raft owns its generator. 0 seeds it from the clock.
+  uint64_t randomSeed;
+
   Config();
 
   Status Validate();
@@ -89,6 +89,18 @@ struct PBMessage {
     return *this;
   }
 
+  // The message owns its fields, so the shared snapshot is copied.
+  PBMessage& Snapshot(const SnapshotSptr& snap) {
+    v.mutable_snapshot()->CopyFrom(*snap);
+    return *this;
+  }
+
+  // Only the metadata of the shared snapshot is copied, see MsgSnapshots.
+  PBMessage& SnapshotMetadata(const SnapshotSptr& snap) {
+    v.mutable_snapshot()->mutable_metadata()->CopyFrom(snap->metadata());
+    return *this;
+  }
+
   PBMessage& Context(std::string* ctx) {
     v.set_allocated_context(ctx);
     return *this;
@@ -180,6 +192,13 @@ struct PBConfChange {
     v.set_nodeid(id);
     return *this;
   }
+
+  PBConfChange& Voters(std::initializer_list<uint64_t> voters) {
+    for (uint64_t id : voters) {
+      v.add_voters(id);
+    }
+    return *this;
+  }
 };
 
 }  // namespace yaraft
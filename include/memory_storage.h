@@ -15,7 +15,10 @@
 
 #pragma once
 
+#include <functional>
+#include <future>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 #include "fluent_pb.h"
@@ -50,7 +53,16 @@ class MemoryStorage : public Storage {
   // ERROR: LogCompacted, OutOfBound.
   virtual StatusWith<EntryVec> Entries(uint64_t lo, uint64_t hi, uint64_t *maxSize) override;
 
-  virtual StatusWith<pb::Snapshot> Snapshot() const override {
+  // The indexes are tracked on append, it doesn't scan the entries.
+  virtual Status ConfChangeIndexes(uint64_t lo, uint64_t hi,
+                                   std::vector<uint64_t> *indexes) override;
+
+  // `fn` is called with the storage locked.
+  // ERROR: LogCompacted, OutOfBound.
+  virtual Status ForEachEntry(uint64_t lo, uint64_t hi, uint64_t *maxSize,
+                              const EntryVisitor &fn) override;
+
+  virtual StatusWith<SnapshotSptr> Snapshot() const override {
     std::lock_guard<std::mutex> guard(mu_);
     return snapshot_;
   }
@@ -61,21 +73,48 @@ class MemoryStorage : public Storage {
   }
 
  public:
-  MemoryStorage() {
+  MemoryStorage() : snapshot_(new pb::Snapshot) {
     // When starting from scratch populate the list with a dummy entry at term zero,
     // so AppendEntries can be applied with prevLogIndex=0, prevLogTerm=0 when there's no
     // entries in storage.
     entries_.push_back(PBEntry().Index(0).Term(0).v);
+    sizes_.push_back(0);
   }
 
   explicit MemoryStorage(EntryVec vec) : MemoryStorage() {
     Append(vec);
   }
 
+  ~MemoryStorage();
+
   // Compact discards all log entries prior to compactIndex.
   // It is the application's responsibility to not attempt to compact an index
   // greater than raftLog.applied.
-  Status Compact(uint64_t compactIndex);
+  Status Compact(uint64_t compactIndex) {
+    std::lock_guard<std::mutex> guard(mu_);
+    return unsafeCompact(compactIndex);
+  }
+
+  // SnapshotDataProducer serializes the state machine. It runs on a background
+  // thread, so it must read from a point-in-time view of the state machine (for example
+  // a copy-on-write reference) captured when the snapshot is requested, rather than
+  // from the live state that the raft thread keeps applying to.
+  using SnapshotDataProducer = std::function<std::string()>;
+
+  // CreateSnapshot builds a snapshot of index `index` in background, then atomically
+  // installs it and compacts the log up to `index`. The calling thread (usually the raft
+  // thread) never waits for `producer`, and Term, Entries, Append are only blocked during
+  // the final installation.
+  // It is the application's responsibility to not create a snapshot at an index
+  // greater than raftLog.applied.
+  // Only one snapshot can be in creation at a time.
+  //
+  // The returned future is set to the result after the creation finished, or to
+  // the exception thrown by `producer`.
+  // ERROR: LogCompacted, OutOfBound, SnapshotUnavailable (another creation is in progress),
+  // SnapshotOutOfDate (a newer snapshot was applied during creation).
+  std::future<Status> CreateSnapshot(uint64_t index, pb::ConfState confState,
+                                     SnapshotDataProducer producer);
 
   // SetHardState saves the current HardState.
   void SetHardState(pb::HardState st) {
@@ -104,17 +143,28 @@ class MemoryStorage : public Storage {
     if (end < lastIndex() && end >= firstIndex()) {
       // truncate the existing entries
       entries_.resize(end - entries_.begin()->index() + 1);
+      sizes_.resize(std::min(sizes_.size(), entries_.size()));
+      confIndexes_.erase(std::upper_bound(confIndexes_.begin(), confIndexes_.end(), end),
+                         confIndexes_.end());
     }
   }
 
   // ApplySnapshot overwrites the contents of this Storage object with
   // those of the given snapshot.
   void ApplySnapshot(pb::Snapshot &snap) {
+    auto s = new pb::Snapshot;
+    s->Swap(&snap);
+    ApplySnapshot(SnapshotSptr(s));
+  }
+
+  void ApplySnapshot(SnapshotSptr snap) {
     std::lock_guard<std::mutex> guard(mu_);
-    snapshot_.Swap(&snap);
+    snapshot_ = std::move(snap);
     entries_.clear();
     entries_.push_back(
-        PBEntry().Term(snapshot_.metadata().term()).Index(snapshot_.metadata().index()).v);
+        PBEntry().Term(snapshot_->metadata().term()).Index(snapshot_->metadata().index()).v);
+    sizes_.assign(1, 0);
+    confIndexes_.clear();
   }
 
  private:
@@ -128,23 +178,49 @@ class MemoryStorage : public Storage {
 
   void unsafeAppend(pb::Entry &entry);
 
+  // syncSizes computes the sizes of the entries that sizes_ doesn't cover yet.
+  void syncSizes();
+
+  Status unsafeCompact(uint64_t compactIndex);
+
+  Status installSnapshot(SnapshotSptr snap);
+
  public:
   /// The following functions are for test only.
 
   std::vector<pb::Entry> &TEST_Entries() {
+    // the entries may be changed by the caller.
+    sizes_.clear();
+    confIndexesStale_ = true;
     return entries_;
   }
 
  private:
   pb::HardState hardState_;
-  pb::Snapshot snapshot_;
+  SnapshotSptr snapshot_;
 
   // Operations like Storage::Term, Storage::Entries require random access of the
   // underlying data structure. In terms of performance, we choose
   // std::vector to store entries.
   std::vector<pb::Entry> entries_;
 
+  // sizes_[i] is the total encoded size of entries_[1..i] plus a base, so the
+  // size of a range is the difference of two elements, and the cut point of
+  // maxSize is binary searched. It covers a prefix of entries_, the rest is
+  // computed on demand by syncSizes.
+  std::vector<uint64_t> sizes_;
+
+  // the indexes of the EntryConfChange entries in entries_, in order. They are
+  // rebuilt if confIndexesStale_ is set.
+  std::vector<uint64_t> confIndexes_;
+  bool confIndexesStale_{false};
+
   mutable std::mutex mu_;
+
+  // protects the snapshot creation thread.
+  std::mutex snapMu_;
+  std::thread snapThread_;
+  bool creatingSnap_{false};
 };
 
 using MemStoreUptr = std::unique_ptr<MemoryStorage>;
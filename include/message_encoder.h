@@ -0,0 +1,92 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pb_utils.h"
+
+#include <yaraft/pb/raftpb.pb.h>
+
+namespace yaraft {
+
+// MessageEncoder serializes MessageBatches to the protobuf wire format. The
+// leader sends the same entries in the MsgApps to every follower, so instead of
+// having protobuf encode them again for each follower, the encoder keeps the
+// encodings of the recently sent entries and assembles a MsgApp from its
+// header plus the cached `entries` field bytes.
+//
+// By the Log Matching Property two entries with the same index and term are
+// identical, so (index, term) identifies an encoding. That only holds for the
+// entries in the log, so the entries of other messages, like the forwarded
+// MsgProps whose entries all have index 0, are always encoded.
+//
+// Likewise a detached MsgSnap carries only the snapshot metadata, see
+// Config::detachSnapshots. Its image is encoded once by EncodeSnapshots for
+// all the followers it's sent to, and released with the result.
+//
+// MessageEncoder is not thread-safe.
+class MessageEncoder {
+ public:
+  // `capacity` is the number of entry encodings kept.
+  explicit MessageEncoder(size_t capacity = 1024);
+
+  // EncodedSnapshots maps the snapshot index to the encoded image.
+  typedef std::unordered_map<uint64_t, std::string> EncodedSnapshots;
+
+  // EncodeSnapshots encodes the images in `snaps` of the MsgSnaps in
+  // `batches`. It touches no state of the encoder, so it may run without
+  // holding the lock that guards the encoder.
+  static EncodedSnapshots EncodeSnapshots(const std::vector<pb::MessageBatch>& batches,
+                                          const MsgSnapshots& snaps);
+
+  // AppendBatch appends the encoding of `batch` to `out`. The result parses
+  // to a MessageBatch equal to `batch`, except that the MsgSnaps carry their
+  // images in `snaps`. The messages in `batch` are unchanged after the call,
+  // though they are temporarily modified during it.
+  void AppendBatch(pb::MessageBatch* batch, const EncodedSnapshots& snaps, std::string* out);
+
+  void AppendBatch(pb::MessageBatch* batch, std::string* out) {
+    AppendBatch(batch, EncodedSnapshots(), out);
+  }
+
+  // Encodes returns the number of entries that have been encoded, excluding
+  // those served from the cache.
+  uint64_t Encodes() const {
+    return encodes_;
+  }
+
+ private:
+  void appendMessage(pb::Message* m, std::string* out);
+
+  void appendSnapshot(pb::Message* m, const std::string& image, std::string* out);
+
+  const std::string& encodeEntry(const pb::Entry& e);
+
+ private:
+  struct Slot {
+    uint64_t index;
+    uint64_t term;
+    std::string bytes;
+  };
+
+  // slots_[i % capacity] holds the encoding of the entry at index i.
+  std::vector<Slot> slots_;
+  uint64_t encodes_;
+};
+
+}  // namespace yaraft
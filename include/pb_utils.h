@@ -14,7 +14,9 @@
 
 #pragma once
 
+#include <memory>
 #include <ostream>
+#include <unordered_map>
 
 #include <yaraft/pb/raftpb.pb.h>
 
@@ -22,6 +24,15 @@ namespace yaraft {
 
 typedef std::vector<pb::Entry> EntryVec;
 
+// Snapshots are immutable once created, they are shared between storage, unstable
+// and the outgoing messages rather than copied.
+typedef std::shared_ptr<const pb::Snapshot> SnapshotSptr;
+
+// An outgoing MsgSnap carries only the metadata of its snapshot, so that the
+// image is shared by all the followers it's sent to. MsgSnapshots maps the
+// snapshot index to the image, see Ready::msgSnapshots.
+typedef std::unordered_map<uint64_t, SnapshotSptr> MsgSnapshots;
+
 inline bool IsLocalMessage(pb::MessageType msgt) {
   switch (msgt) {
     case pb::MsgHup:
@@ -52,6 +63,18 @@ inline bool IsEmptySnapshot(const pb::Snapshot& snap) {
   return snap.metadata().index() == 0;
 }
 
+// AttachSnapshot copies the image of the snapshot of the MsgSnap `m` from
+// `snaps` into `m`, if there is one.
+inline void AttachSnapshot(pb::Message* m, const MsgSnapshots& snaps) {
+  if (m->type() != pb::MsgSnap) {
+    return;
+  }
+  auto it = snaps.find(m->snapshot().metadata().index());
+  if (it != snaps.end()) {
+    m->mutable_snapshot()->CopyFrom(*it->second);
+  }
+}
+
 pb::MessageType GetResponseType(pb::MessageType type);
 
 // Print the message in a single line, useful for logging or other purposes.
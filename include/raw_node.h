@@ -15,6 +15,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 
 #include "read_only.h"
 #include "slice.h"
@@ -29,11 +30,15 @@ class Config;
 class Ready;
 
 struct RaftProgress {
-  RaftProgress(uint64_t next, uint64_t match) : nextIndex(next), matchIndex(match) {}
-  RaftProgress() : nextIndex(0), matchIndex(0) {}
+  RaftProgress(uint64_t next, uint64_t match, uint64_t resps = 0)
+      : nextIndex(next), matchIndex(match), appResps(resps) {}
+  RaftProgress() : nextIndex(0), matchIndex(0), appResps(0) {}
 
   uint64_t nextIndex;
   uint64_t matchIndex;
+
+  // the number of MsgAppResps the leader has handled from this peer.
+  uint64_t appResps;
 };
 
 class RawNode {
@@ -48,10 +53,18 @@ class RawNode {
   // Step advances the state machine using the given message.
   Status Step(pb::Message &m);
 
+  // StepBatch steps the messages in order. The commit index advanced by a run
+  // of MsgAppResps is broadcast once after the run rather than once per
+  // response. The messages Step rejects are skipped, and the status of the
+  // first of them is returned.
+  Status StepBatch(std::vector<pb::Message> &msgs);
+
   // Campaign causes this RawNode to transition to candidate state.
   Status Campaign();
 
   // Propose proposes data be appended to the raft log.
+  // On a follower the proposal is forwarded to the leader, unless
+  // Config::disableProposalForwarding is set.
   Status Propose(const Slice &data);
 
   // GetReady returns the current point-in-time state of this RawNode,
@@ -69,15 +82,30 @@ class RawNode {
   // ProposeConfChange proposes a config change.
   Status ProposeConfChange(const pb::ConfChange &cc);
 
-  // ApplyConfChange applies a config change to the local node.
+  // ApplyConfChange applies a config change to the local node, and returns
+  // the voters and learners of the resulting configuration.
+  // ConfChangeAddNode on an existing learner promotes it to voter.
+  // ConfChangeBeginJoint replaces the voters with ConfChange::Voters through a
+  // joint consensus; the leader proposes ConfChangeLeaveJoint by itself after
+  // applying it, and the applications apply that entry as any other one.
   pb::ConfState ApplyConfChange(const pb::ConfChange &cc);
 
+  // TransferLeader tries to transfer leadership to the given transferee.
+  // The leader catches the transferee up and then asks it to campaign immediately.
+  // Proposals are dropped while the transfer is in progress, which is aborted
+  // if it doesn't finish within an election timeout.
+  Status TransferLeader(uint64_t transferee);
+
   // ReadIndex requests a read state. The read state will be set in ready.
   // Read State has a read index. Once the application advances further than the read
   // index, any linearizable read requests issued before the read request can be
-  // processed safely. The read state will have the same rctx attached.
-  // TODO(wutao1): using uint64 instead of std::string to serialize read index.
-  Status ReadIndex(std::string &ctx);
+  // processed safely. The read state will have the returned request id attached.
+  // On a follower the request is forwarded to the leader, and the read state
+  // is set once the leader has confirmed the read index, so that the read can be
+  // served locally after the follower has applied up to the index.
+  // All the requests made between two GetReady calls are confirmed together
+  // by a single round of heartbeat.
+  StatusWith<uint64_t> ReadIndex();
 
   // feel free to call this function without lock protection, since the Id
   // never changes.
@@ -95,6 +123,9 @@ class RawNode {
     return LeaderHint() == Id();
   }
 
+  // LeadTransferee returns the target of the ongoing leader transfer, 0 if none.
+  uint64_t LeadTransferee() const;
+
   std::unordered_map<uint64_t, RaftProgress> ProgressMap();
 
  private:
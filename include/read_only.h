@@ -15,8 +15,9 @@
 #pragma once
 
 #include <cstdint>
-#include <deque>
-#include <unordered_set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <yaraft/pb/raftpb.pb.h>
 
@@ -25,38 +26,139 @@ namespace yaraft {
 // ReadState provides state for read only query.
 // It's caller's responsibility to call ReadIndex first before getting
 // this state from ready, it's also caller's duty to differentiate if this
-// state is what it requests through RequestCtx, eg. given a unique id as
-// RequestCtx
+// state is what it requests through requestId, which is returned by ReadIndex.
 struct ReadState {
   uint64_t index;
-  std::string requestCtx;
+  uint64_t requestId;
+};
+
+// The id of a read only request, or of a batch of them, is carried as the
+// context of MsgReadIndex, MsgHeartbeat(Resp) and MsgReadIndexResp, encoded
+// in 8 bytes little-endian. 0 is never used as an id.
+inline std::string EncodeReadContext(uint64_t id) {
+  std::string ctx(8, '\0');
+  for (int i = 0; i < 8; i++) {
+    ctx[i] = static_cast<char>((id >> (i * 8)) & 0xff);
+  }
+  return ctx;
+}
+
+// Returns 0 if `ctx` is not an encoded read context.
+inline uint64_t DecodeReadContext(const std::string &ctx) {
+  if (ctx.size() != 8) {
+    return 0;
+  }
+  uint64_t id = 0;
+  for (int i = 7; i >= 0; i--) {
+    id = (id << 8) | static_cast<uint8_t>(ctx[i]);
+  }
+  return id;
+}
+
+// kMaxVoters is the maximum number of voters in a raft group. The leader keeps
+// the acks of a read only request in a 64-bit bitmap, one bit for each of the
+// other voters.
+const size_t kMaxVoters = 64;
+
+// ReadRequest is a read only request waiting for its read index.
+// `from` is the node that issued the request, `id` is the request id
+// assigned by that node.
+struct ReadRequest {
+  uint64_t from;
+  uint64_t id;
 };
 
 struct ReadIndexStatus {
   uint64_t index;
 
-  std::unordered_set<uint64_t> acks;
+  // the read only requests confirmed together by one round of heartbeat.
+  std::vector<ReadRequest> reqs;
+
+  // bitmap of the peer slots that have acknowledged the heartbeat.
+  uint64_t acks;
 };
 
-struct ReadOnly {
-  // addRequest adds a read only reuqest into readonly struct.
+// ReadOnly keeps the batches of read only requests waiting for the heartbeat
+// round that confirms them. The batches are kept in a ring buffer indexed by
+// their sequence numbers, which are assigned consecutively, so that both RecvAck
+// and Advance are O(1) amortized and reuse the buffers in steady state.
+class ReadOnly {
+ public:
+  ReadOnly();
+
+  // AddRequest adds a batch of read only requests into readonly struct and
+  // returns its sequence number, which is attached to the heartbeats that confirm it.
   // `index` is the commit index of the raft state machine when it received
-  // the read only request.
-  // `m` is the original read only request message from the local or remote node.
-  void AddRequest(uint64_t idx, const pb::Message &m);
+  // the read only requests.
+  // The requests are taken from `reqs`, which is left empty.
+  uint64_t AddRequest(uint64_t idx, std::vector<ReadRequest> *reqs);
 
   // RecvAck notifies the readonly struct that the raft state machine received
   // an acknowledgment of the heartbeat that attached with the read only request
-  // context.
+  // context. It returns the number of acknowledgments including the local node's.
   int RecvAck(const pb::Message &m);
 
+  // Acked returns whether `id` has acknowledged the heartbeat attached with the
+  // read only request context of `m`.
+  bool Acked(const pb::Message &m, uint64_t id) const;
+
   // Advance advances the read only request queue kept by the readonly struct.
-  // It dequeues the requests until it finds the read only request that has
-  // the same context as the given `m`.
-  void Advance(const pb::Message &m, std::vector<ReadState> *readStates);
+  // It dequeues the batches until it finds the one that has the same
+  // context as the given `m`, calling `fn(index, reqs)` on each of them.
+  template <typename Fn>
+  void Advance(const pb::Message &m, Fn &&fn) {
+    uint64_t seq = DecodeReadContext(m.context());
+    if (!isPending(seq)) {
+      return;
+    }
+
+    // batches are confirmed in order, since each of them is sent out after the
+    // previous ones.
+    while (head_ <= seq) {
+      ReadIndexStatus &rs = slot(head_);
+      fn(rs.index, rs.reqs);
+      rs.reqs.clear();
+      head_++;
+    }
+  }
+
+  // Reset drops all pending read only requests.
+  void Reset();
+
+  // RemovePeer drops the acks from `id`, which has been removed from the
+  // configuration, and frees its slot in the ack bitmaps.
+  void RemovePeer(uint64_t id);
+
+  size_t PendingSize() const {
+    return static_cast<size_t>(tail_ - head_);
+  }
+
+ private:
+  bool isPending(uint64_t seq) const {
+    return seq >= head_ && seq < tail_;
+  }
+
+  ReadIndexStatus &slot(uint64_t seq) {
+    return ring_[seq & (ring_.size() - 1)];
+  }
+
+  int peerSlot(uint64_t id);
+
+  void grow();
+
+ private:
+  // ring_.size() is always a power of 2.
+  std::vector<ReadIndexStatus> ring_;
+
+  // sequence numbers of the pending batches are in [head_, tail_).
+  uint64_t head_;
+  uint64_t tail_;
+
+  // peer id -> bit in ReadIndexStatus::acks
+  std::unordered_map<uint64_t, int> peerSlots_;
 
-  std::map<std::string, ReadIndexStatus> pendingReadIndex;
-  std::deque<std::string> readIndexQueue;
+  // bitmap of the slots in peerSlots_.
+  uint64_t usedSlots_;
 };
 
-}  // namespace yaraft
\ No newline at end of file
+}  // namespace yaraft
@@ -16,6 +16,7 @@
 #pragma once
 
 #include "memory_storage.h"
+#include "read_only.h"
 #include "storage.h"
 
 #include <yaraft/pb/raftpb.pb.h>
@@ -36,7 +37,7 @@ struct Ready {
   EntryVec entries;
 
   // Snapshot specifies the snapshot to be saved to stable storage.
-  std::unique_ptr<pb::Snapshot> snapshot;
+  SnapshotSptr snapshot;
 
   // Messages specifies outbound messages to be sent AFTER Entries are
   // committed to stable storage.
@@ -44,12 +45,30 @@ struct Ready {
   // when the snapshot has been received or has failed by calling ReportSnapshot.
   std::vector<pb::Message> messages;
 
+  // batches replaces `messages` when Config::batchMessages is set, it holds
+  // one batch for each destination, in the order of their first messages.
+  std::vector<pb::MessageBatch> batches;
+
+  // msgSnapshots holds the images of the MsgSnaps in messages or batches when
+  // Config::detachSnapshots is set, the MsgSnaps carry only the snapshot
+  // metadata then. Transport::Send attaches them.
+  MsgSnapshots msgSnapshots;
+
+  // readStates can be used for node to serve linearizable read requests locally
+  // when its applied index is greater than the index in ReadState.
+  // Note that the readState will be returned when raft receives MsgReadIndex.
+  // The returned is only valid for the request that requested to read.
+  // The read states are moved out of raft on each GetReady, each of them is
+  // returned exactly once. See AppliedIndex for waiting on the applied index.
+  std::vector<ReadState> readStates;
+
   // current leader of the raft group
   uint64_t currentLeader;
 
  public:
   bool IsEmpty() const {
-    return (!hardState) && entries.empty() && (!snapshot) && messages.empty();
+    return (!hardState) && entries.empty() && (!snapshot) && messages.empty() &&
+           batches.empty() && readStates.empty();
   }
 
   void Advance(MemoryStorage* store) {
@@ -64,7 +83,7 @@ struct Ready {
 
     if (snapshot) {
       assert(IsEmptySnapshot(*snapshot));
-      snapshot.reset(nullptr);
+      snapshot.reset();
     }
   }
 };
@@ -32,6 +32,9 @@ class Error {
     StepPeerNotFound,
     SnapshotUnavailable,
     NotLeader,
+    SnapshotOutOfDate,
+    ProposalDropped,
+    NetworkError,
 
     ErrorCodesNum
   };
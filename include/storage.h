@@ -16,6 +16,8 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <vector>
 
 #include "pb_utils.h"
@@ -52,15 +54,47 @@ class Storage {
   // If snapshot is temporarily unavailable, it should return ErrSnapshotTemporarilyUnavailable,
   // so raft state machine could know that Storage needs some time to prepare
   // snapshot and call Snapshot later.
-  virtual StatusWith<pb::Snapshot> Snapshot() const = 0;
+  // The returned snapshot is shared with storage and must never be modified.
+  virtual StatusWith<SnapshotSptr> Snapshot() const = 0;
 
   // Entries returns a slice of log entries in the range [lo,hi).
   // MaxSize limits the total size of the log entries returned, but
   // Entries returns at least one entry if any.
   // than reference counted.
-  // TODO(or not): Lazily copy entries out from storage.
+  // See ForEachEntry for visiting the entries without copying them out.
   virtual StatusWith<EntryVec> Entries(uint64_t lo, uint64_t hi, uint64_t *maxSize) = 0;
 
+  using EntryVisitor = std::function<void(const pb::Entry &)>;
+
+  // ForEachEntry calls `fn` on the log entries that Entries would return, in
+  // order, without copying them out. The entries are borrowed from storage and
+  // only valid during the call, and `fn` must not call back into storage.
+  // The default implementation visits the result of Entries.
+  virtual Status ForEachEntry(uint64_t lo, uint64_t hi, uint64_t *maxSize,
+                              const EntryVisitor &fn) {
+    auto s = Entries(lo, hi, maxSize);
+    if (!s.IsOK()) {
+      return s.GetStatus();
+    }
+    for (const auto &e : s.GetValue()) {
+      fn(e);
+    }
+    return Status::OK();
+  }
+
+  // ConfChangeIndexes appends the indexes of the EntryConfChange entries in
+  // the range [lo,hi) to `indexes` in order. Implementations should keep the
+  // indexes aside so that it doesn't scan the entries; the default implementation
+  // does.
+  virtual Status ConfChangeIndexes(uint64_t lo, uint64_t hi, std::vector<uint64_t> *indexes) {
+    uint64_t maxSize = std::numeric_limits<uint64_t>::max();
+    return ForEachEntry(lo, hi, &maxSize, [&](const pb::Entry &e) {
+      if (e.type() == pb::EntryConfChange) {
+        indexes->push_back(e.index());
+      }
+    });
+  }
+
   // InitialState returns the saved HardState and ConfState information.
   virtual Status InitialState(pb::HardState *hardState, pb::ConfState *confState) = 0;
 };
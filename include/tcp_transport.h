@@ -0,0 +1,160 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "message_encoder.h"
+#include "transport.h"
+
+namespace yaraft {
+
+class TcpTransportOptions {
+ public:
+  // listenAddr is the address in the form of "ip:port" that the peers connect
+  // to. Port 0 picks an ephemeral port, see TcpTransport::ListenPort.
+  std::string listenAddr;
+
+  // After a peer fails to be connected, the next attempt is delayed by a
+  // backoff starting from minBackoff, which doubles on each failure up to
+  // maxBackoff. Messages to a peer in backoff are dropped.
+  std::chrono::milliseconds minBackoff;
+  std::chrono::milliseconds maxBackoff;
+
+  // maxQueueBytes limits the bytes of messages queued for a peer, including
+  // the ones not yet written to the socket. Messages exceeding the limit are
+  // dropped and the peer is reported unreachable.
+  size_t maxQueueBytes;
+
+  // maxFramesPerWrite limits the number of messages written in one syscall.
+  int maxFramesPerWrite;
+
+  // entryCacheSize is the number of entry encodings kept for the MsgApps to
+  // the other peers, see MessageEncoder.
+  size_t entryCacheSize;
+
+  TcpTransportOptions();
+};
+
+// TcpTransport sends messages over TCP, one outbound connection per peer.
+// The messages to a peer in one Send call are packed into a MessageBatch,
+// which is framed by its 4-byte little-endian length. All the queued frames
+// to a peer are written with a single sendmsg(2) call (up to
+// maxFramesPerWrite), and all the sockets are served by one epoll thread.
+// TcpTransport is only available on Linux.
+class TcpTransport : public Transport {
+ public:
+  TcpTransport(uint64_t id, const TcpTransportOptions& options, TransportHandler* handler);
+
+  ~TcpTransport() override;
+
+  // Start listens on options.listenAddr and starts the IO thread.
+  Status Start();
+
+  // Stop closes all the connections and joins the IO thread. Queued messages
+  // are discarded.
+  void Stop();
+
+  // ListenPort returns the port listened on after Start.
+  uint16_t ListenPort() const {
+    return listenPort_;
+  }
+
+  // `addr` is in the form of "ip:port".
+  Status AddPeer(uint64_t id, const std::string& addr) override;
+
+  void RemovePeer(uint64_t id) override;
+
+  using Transport::Send;
+  using Transport::SendBatches;
+
+  void Send(std::vector<pb::Message>* msgs, const MsgSnapshots& snaps) override;
+
+  // SendBatches writes each batch as one frame. The image of a snapshot is
+  // encoded once for all the MsgSnaps of it, outside of the lock, see
+  // MessageEncoder::EncodeSnapshots.
+  void SendBatches(std::vector<pb::MessageBatch>* batches, const MsgSnapshots& snaps) override;
+
+  /// The following functions are for test only.
+
+  // TEST_Dials returns the number of connection attempts to the peers.
+  uint64_t TEST_Dials() const {
+    return dials_.load();
+  }
+
+ private:
+  struct Frame;
+  struct Peer;
+  struct Conn;
+
+  void loop();
+
+  void wakeup();
+
+  // syncPeers moves the messages queued by Send to the IO thread, and
+  // reconciles the peers added or removed. The messages queued for a removed
+  // peer are failed as if its connection was lost.
+  void syncPeers();
+
+  void dial(Peer* p);
+
+  void flush(Peer* p);
+
+  // fail closes the connection to the peer, drops its queued messages and
+  // starts the backoff.
+  void fail(Peer* p);
+
+  void closePeer(Peer* p);
+
+  void acceptConns();
+
+  void readConn(Conn* c);
+
+  void closeConn(Conn* c);
+
+  int epollTimeout() const;
+
+ private:
+  const uint64_t id_;
+  const TcpTransportOptions options_;
+  TransportHandler* handler_;
+
+  int epfd_;
+  int listenFd_;
+  int wakeFd_;
+  uint16_t listenPort_;
+
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+  std::atomic<uint64_t> dials_;
+
+  // Guards peers_, retired_, the pending queues of the peers and encoder_.
+  std::mutex mu_;
+  std::unordered_map<uint64_t, std::shared_ptr<Peer>> peers_;
+  // the peers removed or replaced, whose queued messages are failed by the IO
+  // thread.
+  std::vector<std::shared_ptr<Peer>> retired_;
+  MessageEncoder encoder_;
+
+  // The states below are only accessed by the IO thread.
+  std::unordered_map<uint64_t, std::shared_ptr<Peer>> active_;
+  std::unordered_map<int, Peer*> outFds_;
+  std::unordered_map<int, std::unique_ptr<Conn>> inConns_;
+};
+
+}  // namespace yaraft
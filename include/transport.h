@@ -0,0 +1,163 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "pb_utils.h"
+#include "raw_node.h"
+#include "status.h"
+
+#include <yaraft/pb/raftpb.pb.h>
+
+namespace yaraft {
+
+// TransportHandler receives the events of a Transport. The callbacks may be
+// invoked from the transport's own thread, so they must not touch a RawNode
+// directly. See RawNodeInbox for an implementation that hands them over to
+// the raft thread.
+class TransportHandler {
+ public:
+  virtual ~TransportHandler() = default;
+
+  // OnMessage is called when a message from a peer is received.
+  virtual void OnMessage(pb::Message msg) = 0;
+
+  // OnUnreachable is called when messages to `to` were dropped because the
+  // peer could not be reached. The raft node should be told by
+  // RawNode::ReportUnreachable.
+  virtual void OnUnreachable(uint64_t to) = 0;
+
+  // OnSnapshotStatus is called when a MsgSnap to `to` has been sent out, or has
+  // failed to. The raft node should be told by RawNode::ReportSnapshot.
+  virtual void OnSnapshotStatus(uint64_t to, RawNode::SnapshotStatus status) = 0;
+};
+
+// Transport delivers Ready::messages to the peers of the raft group.
+class Transport {
+ public:
+  virtual ~Transport() = default;
+
+  // AddPeer registers the address of a peer. Adding an existing peer updates
+  // its address.
+  virtual Status AddPeer(uint64_t id, const std::string& addr) = 0;
+
+  virtual void RemovePeer(uint64_t id) = 0;
+
+  // Send queues the messages for delivery to their destinations, without
+  // blocking on the network. The messages are moved out of `msgs`.
+  // The messages to the same peer are delivered in order. The MsgSnaps are
+  // sent with their images in `snaps`, see Ready::msgSnapshots.
+  virtual void Send(std::vector<pb::Message>* msgs, const MsgSnapshots& snaps) = 0;
+
+  // SendBatches sends Ready::batches, each batch holds messages to the same
+  // peer. The default implementation unpacks the batches and calls Send.
+  virtual void SendBatches(std::vector<pb::MessageBatch>* batches, const MsgSnapshots& snaps);
+
+  void Send(std::vector<pb::Message>* msgs) {
+    Send(msgs, MsgSnapshots());
+  }
+
+  void SendBatches(std::vector<pb::MessageBatch>* batches) {
+    SendBatches(batches, MsgSnapshots());
+  }
+};
+
+// RawNodeInbox buffers the messages and reports coming from a Transport until
+// the raft thread calls Flush, which is typically done before each GetReady.
+class RawNodeInbox : public TransportHandler {
+ public:
+  void OnMessage(pb::Message msg) override;
+
+  void OnUnreachable(uint64_t to) override;
+
+  void OnSnapshotStatus(uint64_t to, RawNode::SnapshotStatus status) override;
+
+  // Flush steps the buffered messages into `node` by RawNode::StepBatch and reports the unreachable
+  // peers and snapshot statuses to it. Returns the number of messages stepped.
+  size_t Flush(RawNode* node);
+
+ private:
+  std::mutex mu_;
+  std::vector<pb::Message> msgs_;
+  std::unordered_set<uint64_t> unreachable_;
+  std::vector<std::pair<uint64_t, RawNode::SnapshotStatus>> snapStatuses_;
+};
+
+// LoopbackTransport delivers messages synchronously to the other transports
+// attached to the same LoopbackNetwork in process. It's intended for tests.
+class LoopbackNetwork;
+
+class LoopbackTransport : public Transport {
+ public:
+  LoopbackTransport(uint64_t id, TransportHandler* handler, LoopbackNetwork* network);
+
+  ~LoopbackTransport() override;
+
+  // The address is ignored, every peer attached to the network is reachable
+  // once it's added.
+  Status AddPeer(uint64_t id, const std::string& addr) override;
+
+  void RemovePeer(uint64_t id) override;
+
+  using Transport::Send;
+
+  // The MsgSnaps are delivered with a copy of their images, since each
+  // receiver owns its messages.
+  void Send(std::vector<pb::Message>* msgs, const MsgSnapshots& snaps) override;
+
+  uint64_t Id() const {
+    return id_;
+  }
+
+ private:
+  friend class LoopbackNetwork;
+
+  const uint64_t id_;
+  TransportHandler* handler_;
+  LoopbackNetwork* network_;
+
+  std::mutex mu_;
+  std::unordered_set<uint64_t> peers_;
+};
+
+class LoopbackNetwork {
+ public:
+  // Isolate drops all the messages from or to `id` until Recover.
+  void Isolate(uint64_t id);
+
+  void Recover();
+
+ private:
+  friend class LoopbackTransport;
+
+  void attach(LoopbackTransport* t);
+
+  void detach(LoopbackTransport* t);
+
+  // deliver returns false if `m.to()` is unreachable from `m.from()`.
+  bool deliver(pb::Message m);
+
+ private:
+  std::mutex mu_;
+  std::unordered_map<uint64_t, LoopbackTransport*> nodes_;
+  std::unordered_set<uint64_t> isolated_;
+};
+
+}  // namespace yaraft
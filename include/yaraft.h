@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <yaraft/applied_index.h>
 #include <yaraft/conf.h>
 #include <yaraft/fluent_pb.h>
 #include <yaraft/memory_storage.h>
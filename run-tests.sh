@@ -23,4 +23,6 @@ run pb_utils_test
 run progress_test
 run raw_node_test
 run raft_snap_test
-run raft_read_only_test
\ No newline at end of file
+run raft_read_only_test
+run transport_test
+run message_encoder_test
\ No newline at end of file
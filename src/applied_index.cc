@@ -0,0 +1,54 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "applied_index.h"
+
+namespace yaraft {
+
+// A waiter can't miss the wakeup: WaitFor increments waiters_ and then loads
+// the applied index, while Advance stores the applied index and then loads
+// waiters_. All four are seq_cst, so at least one side sees the other's write.
+// Either the waiter sees the new index and doesn't sleep, or Advance sees the
+// waiter and notifies under mu_, which the waiter holds from its check until
+// it sleeps.
+void AppliedIndex::Advance(uint64_t index) {
+  uint64_t cur = applied_.load(std::memory_order_relaxed);
+  while (cur < index) {
+    // on failure `cur` is reloaded.
+    if (applied_.compare_exchange_weak(cur, index, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  if (waiters_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> guard(mu_);
+    cond_.notify_all();
+  }
+}
+
+bool AppliedIndex::WaitFor(uint64_t index, std::chrono::milliseconds timeout) {
+  if (Reached(index)) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(mu_);
+  waiters_.fetch_add(1, std::memory_order_seq_cst);
+  bool reached = cond_.wait_for(
+      lock, timeout, [&]() { return applied_.load(std::memory_order_seq_cst) >= index; });
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+  return reached;
+}
+
+}  // namespace yaraft
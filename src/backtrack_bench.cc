@@ -0,0 +1,142 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This benchmark measures how many MsgApp rejections (probes) it takes a new
+// leader to find where the log of a follower diverges, when the follower has a
+// long suffix of entries from a term that never committed:
+//   - legacy: the rejection only carries the follower's last index, as before
+//     the conflict term was reported, so the leader walks back one index per
+//     probe.
+//   - term: the rejection carries the conflicting term, so the leader skips
+//     whole terms.
+// Each MsgApp carries at most one entry, so that a probe costs the same in
+// both modes.
+//
+// Usage: backtrack_bench [divergent suffix length, default 100000]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "conf.h"
+#include "fluent_pb.h"
+#include "logger.h"
+#include "memory_storage.h"
+#include "raw_node.h"
+#include "ready.h"
+
+using namespace yaraft;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NoopLogger : public Logger {
+ public:
+  void Log(LogLevel level, int line, const char* file, const Slice& log) override {}
+};
+
+const uint64_t kCommonPrefix = 1000;
+
+RawNode* newNode(uint64_t id, MemoryStorage* storage) {
+  auto conf = new Config;
+  conf->id = id;
+  conf->peers = {1, 2};
+  conf->electionTick = 10;
+  conf->heartbeatTick = 1;
+  conf->storage = storage;
+  conf->maxSizePerMsg = 0;
+  conf->preVote = false;
+  return new RawNode(conf);
+}
+
+// newLog returns the common prefix of term 1 followed by `suffix` entries of
+// `term`.
+EntryVec newLog(uint64_t suffix, uint64_t term) {
+  EntryVec ents;
+  ents.reserve(kCommonPrefix + suffix);
+  for (uint64_t i = 1; i <= kCommonPrefix + suffix; i++) {
+    ents.push_back(PBEntry().Index(i).Term(i <= kCommonPrefix ? 1 : term).Data("x").v);
+  }
+  return ents;
+}
+
+void run(const char* name, uint64_t suffix, bool legacy) {
+  auto leadStore = new MemoryStorage;
+  leadStore->Append(newLog(suffix, 3));
+  leadStore->SetHardState(PBHardState().Term(3).v);
+  std::unique_ptr<RawNode> lead(newNode(1, leadStore));
+
+  auto followerStore = new MemoryStorage;
+  followerStore->Append(newLog(suffix, 2));
+  followerStore->SetHardState(PBHardState().Term(3).v);
+  std::unique_ptr<RawNode> follower(newNode(2, followerStore));
+
+  auto drain = [](RawNode* node, MemoryStorage* storage) {
+    std::vector<pb::Message> msgs;
+    std::unique_ptr<Ready> rd(node->GetReady());
+    if (rd) {
+      rd->Advance(storage);
+      msgs = std::move(rd->messages);
+    }
+    return msgs;
+  };
+
+  lead->Campaign();
+  uint64_t probes = 0;
+  bool matched = false;
+  auto start = Clock::now();
+  while (!matched) {
+    auto toFollower = drain(lead.get(), leadStore);
+    for (auto& m : toFollower) {
+      follower->Step(m);
+    }
+
+    auto toLeader = drain(follower.get(), followerStore);
+    if (toFollower.empty() && toLeader.empty()) {
+      fprintf(stderr, "%s: replication stalled\n", name);
+      return;
+    }
+    for (auto& m : toLeader) {
+      if (m.type() == pb::MsgAppResp) {
+        if (!m.reject()) {
+          matched = true;
+        } else {
+          probes++;
+          if (legacy) {
+            m.set_rejecthint(follower->LastIndex());
+            m.set_logterm(0);
+          }
+        }
+      }
+      lead->Step(m);
+    }
+  }
+  double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  printf("%-8s suffix: %8llu  probes: %8llu  elapsed: %10.2fms\n", name,
+         static_cast<unsigned long long>(suffix), static_cast<unsigned long long>(probes), elapsed);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  SetLogger(std::unique_ptr<Logger>(new NoopLogger));
+
+  uint64_t suffix = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  run("legacy", suffix, true);
+  run("term", suffix, false);
+  return 0;
+}
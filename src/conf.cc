@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "conf.h"
+#include "read_only.h"
 
 namespace yaraft {
 
@@ -30,6 +31,10 @@ Status Config::Validate() {
     return Status::Make(Error::InvalidConfig, "election tick must be greater than heartbeat tick");
   }
 
+  if (peers.size() > kMaxVoters) {
+    return Status::Make(Error::InvalidConfig, "too many peers");
+  }
+
   if (!storage) {
     return Status::Make(Error::InvalidConfig, "storage cannot be null");
   }
@@ -37,6 +42,16 @@ Status Config::Validate() {
   return Status::OK();
 }
 
-Config::Config() : id(0), heartbeatTick(0), electionTick(0), storage(nullptr) {}
+Config::Config()
+    : id(0),
+      preVote(false),
+      checkQuorum(false),
+      electionTick(0),
+      heartbeatTick(0),
+      storage(nullptr),
+      disableProposalForwarding(false),
+      batchMessages(false),
+      detachSnapshots(false),
+      randomSeed(0) {}
 
 }  // namespace yaraft
\ No newline at end of file
@@ -13,6 +13,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <limits>
+
 #include "memory_storage.h"
 #include "exception.h"
 #include "logging.h"
@@ -36,6 +39,16 @@ StatusWith<uint64_t> MemoryStorage::Term(uint64_t i) const {
 }
 
 StatusWith<EntryVec> MemoryStorage::Entries(uint64_t lo, uint64_t hi, uint64_t *maxSize) {
+  std::vector<pb::Entry> ret;
+  auto s = ForEachEntry(lo, hi, maxSize, [&](const pb::Entry &e) { ret.push_back(e); });
+  if (!s.IsOK()) {
+    return s;
+  }
+  return ret;
+}
+
+Status MemoryStorage::ForEachEntry(uint64_t lo, uint64_t hi, uint64_t *maxSize,
+                                   const EntryVisitor &fn) {
   LOG_ASSERT(lo <= hi);
 
   std::lock_guard<std::mutex> guard(mu_);
@@ -50,26 +63,55 @@ StatusWith<EntryVec> MemoryStorage::Entries(uint64_t lo, uint64_t hi, uint64_t *
     return Status::Make(Error::OutOfBound);
   }
 
+  if (lo == hi) {
+    return Status::OK();
+  }
+  syncSizes();
+
+  // the first entry is always returned, the following ones are within maxSize.
   uint64_t loOffset = lo - entries_.begin()->index();
-  int size = entries_[loOffset].ByteSize();
+  uint64_t hiOffset = hi - entries_.begin()->index();
+  uint64_t base = sizes_[loOffset - 1];
+  uint64_t endOffset = hiOffset;
+  if (*maxSize <= std::numeric_limits<uint64_t>::max() - base) {
+    endOffset = std::upper_bound(sizes_.begin() + loOffset + 1, sizes_.begin() + hiOffset,
+                                 base + *maxSize) -
+                sizes_.begin();
+  }
 
-  std::vector<pb::Entry> ret;
-  ret.push_back(entries_[loOffset]);
-
-  for (int i = 1; i < hi - lo; i++) {
-    auto &e = entries_[i + loOffset];
-    size += e.ByteSize();
-    if (size > *maxSize) {
-      size -= e.ByteSize();
-      break;
+  for (uint64_t i = loOffset; i < endOffset; i++) {
+    fn(entries_[i]);
+  }
+  *maxSize -= sizes_[endOffset - 1] - base;
+  return Status::OK();
+}
+
+Status MemoryStorage::ConfChangeIndexes(uint64_t lo, uint64_t hi,
+                                        std::vector<uint64_t> *indexes) {
+  LOG_ASSERT(lo <= hi);
+
+  std::lock_guard<std::mutex> guard(mu_);
+  if (lo <= entries_.begin()->index()) {
+    return Status::Make(Error::LogCompacted);
+  }
+
+  if (confIndexesStale_) {
+    confIndexes_.clear();
+    for (auto &e : entries_) {
+      if (e.type() == pb::EntryConfChange) {
+        confIndexes_.push_back(e.index());
+      }
     }
-    ret.push_back(e);
+    confIndexesStale_ = false;
   }
-  *maxSize -= size;
-  return ret;
+
+  auto begin = std::lower_bound(confIndexes_.begin(), confIndexes_.end(), lo);
+  auto end = std::lower_bound(begin, confIndexes_.end(), hi);
+  indexes->insert(indexes->end(), begin, end);
+  return Status::OK();
 }
 
-Status MemoryStorage::Compact(uint64_t compactIndex) {
+Status MemoryStorage::unsafeCompact(uint64_t compactIndex) {
   uint64_t beginIndex = entries_.begin()->index();
   if (compactIndex <= beginIndex) {
     return Status::Make(Error::LogCompacted);
@@ -77,11 +119,9 @@ Status MemoryStorage::Compact(uint64_t compactIndex) {
 
   if (compactIndex > lastIndex()) {
 #ifdef BUILD_TESTS
-    throw RaftError("compact %d is out of bound lastindex(%d)", compactIndex,
-                    LastIndex().GetValue());
+    throw RaftError("compact %d is out of bound lastindex(%d)", compactIndex, lastIndex());
 #else
-    FMT_LOG(FATAL, "compact %d is out of bound lastindex(%d)", compactIndex,
-            LastIndex().GetValue());
+    FMT_SLOG(FATAL, "compact %d is out of bound lastindex(%d)", compactIndex, lastIndex());
 #endif
   }
 
@@ -98,6 +138,111 @@ Status MemoryStorage::Compact(uint64_t compactIndex) {
   }
 
   entries_.resize(l);
+
+  confIndexes_.erase(confIndexes_.begin(), std::upper_bound(confIndexes_.begin(),
+                                                           confIndexes_.end(), compactIndex));
+
+  // the sizes stay valid relative to each other.
+  if (sizes_.size() > compactOffset) {
+    sizes_.erase(sizes_.begin(), sizes_.begin() + compactOffset);
+  } else {
+    sizes_.assign(1, 0);
+  }
+  return Status::OK();
+}
+
+MemoryStorage::~MemoryStorage() {
+  std::thread t;
+  {
+    std::lock_guard<std::mutex> guard(snapMu_);
+    t.swap(snapThread_);
+  }
+  if (t.joinable()) {
+    t.join();
+  }
+}
+
+std::future<Status> MemoryStorage::CreateSnapshot(uint64_t index, pb::ConfState confState,
+                                                  SnapshotDataProducer producer) {
+  std::shared_ptr<std::promise<Status>> promise(new std::promise<Status>);
+  std::future<Status> future = promise->get_future();
+
+  // The term is fetched before returning, the entries before applied index are never
+  // truncated, so it keeps valid until the snapshot is installed, unless the log was
+  // compacted or overwritten by a newer snapshot in the meantime.
+  auto sTerm = Term(index);
+  if (!sTerm.IsOK()) {
+    promise->set_value(sTerm.GetStatus());
+    return future;
+  }
+  uint64_t term = sTerm.GetValue();
+
+  std::lock_guard<std::mutex> guard(snapMu_);
+  if (creatingSnap_) {
+    promise->set_value(
+        Status::Make(Error::SnapshotUnavailable, "another snapshot is being created"));
+    return future;
+  }
+
+  // the previous creation has already finished.
+  if (snapThread_.joinable()) {
+    snapThread_.join();
+  }
+
+  creatingSnap_ = true;
+  auto cs = std::make_shared<pb::ConfState>();
+  cs->Swap(&confState);
+  snapThread_ = std::thread([this, index, term, cs, producer, promise]() {
+    // an exception thrown by the producer is passed to the future, and the
+    // next creation is allowed.
+    std::string data;
+    try {
+      data = producer();
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> g(snapMu_);
+        creatingSnap_ = false;
+      }
+      promise->set_exception(std::current_exception());
+      return;
+    }
+
+    auto snap = new pb::Snapshot;
+    snap->mutable_data()->swap(data);
+    snap->mutable_metadata()->set_index(index);
+    snap->mutable_metadata()->set_term(term);
+    snap->mutable_metadata()->mutable_conf_state()->Swap(cs.get());
+
+    Status s = installSnapshot(SnapshotSptr(snap));
+    {
+      std::lock_guard<std::mutex> g(snapMu_);
+      creatingSnap_ = false;
+    }
+    promise->set_value(s);
+  });
+
+  return future;
+}
+
+Status MemoryStorage::installSnapshot(SnapshotSptr snap) {
+  uint64_t index = snap->metadata().index();
+
+  std::lock_guard<std::mutex> guard(mu_);
+  if (index <= snapshot_->metadata().index()) {
+    return Status::Make(Error::SnapshotOutOfDate);
+  }
+  if (index < entries_.begin()->index()) {
+    return Status::Make(Error::LogCompacted);
+  }
+  if (index > lastIndex() || entries_[index - entries_.begin()->index()].term() !=
+                                 snap->metadata().term()) {
+    return Status::Make(Error::SnapshotOutOfDate, "log has been overwritten");
+  }
+
+  snapshot_ = std::move(snap);
+  if (index > entries_.begin()->index()) {
+    return unsafeCompact(index);
+  }
   return Status::OK();
 }
 
@@ -110,13 +255,37 @@ void MemoryStorage::unsafeAppend(pb::Entry &entry) {
   if (index > last) {
     // ensures the entries are continuous.
     DLOG_ASSERT(index - last == 1);
+    if (sizes_.size() == entries_.size()) {
+      sizes_.push_back(sizes_.back() + entry.ByteSize());
+    }
+    if (entry.type() == pb::EntryConfChange) {
+      confIndexes_.push_back(index);
+    }
     entries_.push_back(std::move(entry));
     return;
   }
 
   // replace the old record if overlapped.
+  auto it = std::lower_bound(confIndexes_.begin(), confIndexes_.end(), index);
+  bool wasConf = it != confIndexes_.end() && *it == index;
+  if (entry.type() == pb::EntryConfChange && !wasConf) {
+    confIndexes_.insert(it, index);
+  } else if (entry.type() != pb::EntryConfChange && wasConf) {
+    confIndexes_.erase(it);
+  }
+
   auto offset = entry.index() - entries_.begin()->index();
   entries_[offset] = std::move(entry);
+  sizes_.resize(std::min(sizes_.size(), offset));
+}
+
+void MemoryStorage::syncSizes() {
+  if (sizes_.empty()) {
+    sizes_.push_back(0);
+  }
+  for (size_t i = sizes_.size(); i < entries_.size(); i++) {
+    sizes_.push_back(sizes_.back() + entries_[i].ByteSize());
+  }
 }
 
 }  // namespace yaraft
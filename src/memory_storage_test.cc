@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include <memory>
+#include <stdexcept>
 
 #include "memory_storage.h"
 #include "test_utils.h"
@@ -119,6 +120,75 @@ TEST_F(MemoryStorageTest, Entries) {
   }
 }
 
+// This test ensures ForEachEntry visits the entries in storage without
+// copying them.
+TEST_F(MemoryStorageTest, ForEachEntry) {
+  auto ents = pbEntry(3, 3) + pbEntry(4, 4) + pbEntry(5, 5) + pbEntry(6, 6);
+  MemStoreUptr storage(new MemoryStorage());
+  storage->TEST_Entries().clear();
+  storage->TEST_Entries() << ents;
+
+  std::vector<const pb::Entry*> visited;
+  uint64_t maxSize = ents[1].ByteSize() + ents[2].ByteSize();
+  ASSERT_OK(storage->ForEachEntry(4, 7, &maxSize,
+                                  [&](const pb::Entry& e) { visited.push_back(&e); }));
+  ASSERT_EQ(visited.size(), 2);
+  ASSERT_EQ(visited[0], &storage->TEST_Entries()[1]);
+  ASSERT_EQ(visited[1], &storage->TEST_Entries()[2]);
+  ASSERT_EQ(maxSize, 0);
+
+  maxSize = std::numeric_limits<uint64_t>::max();
+  auto s = storage->ForEachEntry(3, 5, &maxSize, [&](const pb::Entry& e) { FAIL(); });
+  ASSERT_EQ(s.Code(), Error::LogCompacted);
+}
+
+// This test ensures the size limit of Entries follows the overwritten and
+// compacted entries.
+TEST_F(MemoryStorageTest, EntriesSizeAfterOverwrite) {
+  MemStoreUptr storage(new MemoryStorage());
+  storage->Append({pbEntry(1, 1), pbEntry(2, 1), pbEntry(3, 1), pbEntry(4, 1)});
+
+  auto large = PBEntry().Index(3).Term(2).Data(std::string(100, 'x')).v;
+  storage->Append(large);
+  ASSERT_OK(storage->Compact(1));
+
+  uint64_t maxSize = pbEntry(2, 1).ByteSize() + large.ByteSize();
+  auto s = storage->Entries(2, 5, &maxSize);
+  ASSERT_OK(s.GetStatus());
+  EntryVec_ASSERT_EQ(s.GetValue(), EntryVec({pbEntry(2, 1), large}));
+  ASSERT_EQ(maxSize, 0);
+
+  maxSize = pbEntry(2, 1).ByteSize();
+  s = storage->Entries(2, 5, &maxSize);
+  ASSERT_OK(s.GetStatus());
+  ASSERT_EQ(s.GetValue().size(), 1);
+}
+
+TEST_F(MemoryStorageTest, ConfChangeIndexes) {
+  auto conf = [](uint64_t i, uint64_t t) {
+    return PBEntry().Index(i).Term(t).Type(pb::EntryConfChange).v;
+  };
+  auto indexes = [](MemoryStorage* storage, uint64_t lo, uint64_t hi) {
+    std::vector<uint64_t> ret;
+    EXPECT_TRUE(storage->ConfChangeIndexes(lo, hi, &ret).IsOK());
+    return ret;
+  };
+
+  MemStoreUptr storage(new MemoryStorage());
+  storage->Append({pbEntry(1, 1), conf(2, 1), pbEntry(3, 1), conf(4, 1), conf(5, 1)});
+  ASSERT_EQ(indexes(storage.get(), 1, 6), std::vector<uint64_t>({2, 4, 5}));
+  ASSERT_EQ(indexes(storage.get(), 3, 5), std::vector<uint64_t>({4}));
+
+  // overwrite
+  storage->Append({conf(3, 2), pbEntry(4, 2)});
+  ASSERT_EQ(indexes(storage.get(), 1, 6), std::vector<uint64_t>({2, 3}));
+
+  // compact
+  ASSERT_OK(storage->Compact(2));
+  ASSERT_EQ(storage->ConfChangeIndexes(2, 6, nullptr).Code(), Error::LogCompacted);
+  ASSERT_EQ(indexes(storage.get(), 3, 6), std::vector<uint64_t>({3}));
+}
+
 TEST_F(MemoryStorageTest, Append) {
   struct TestData {
     EntryVec entries;
@@ -166,3 +236,103 @@ TEST_F(MemoryStorageTest, Append) {
     EntryVec_ASSERT_EQ(storage->TEST_Entries(), t.went);
   }
 }
+
+TEST_F(MemoryStorageTest, SnapshotIsShared) {
+  MemStoreUptr storage(new MemoryStorage());
+  ASSERT_TRUE(IsEmptySnapshot(*storage->Snapshot().GetValue()));
+
+  auto snap = PBSnapshot().MetaIndex(4).MetaTerm(4).MetaConfState({1, 2, 3}).v;
+  storage->ApplySnapshot(snap);
+
+  SnapshotSptr s1 = storage->Snapshot().GetValue();
+  SnapshotSptr s2 = storage->Snapshot().GetValue();
+  ASSERT_EQ(s1.get(), s2.get());
+  ASSERT_EQ(s1->metadata().index(), 4);
+  ASSERT_EQ(s1->metadata().term(), 4);
+
+  // the old snapshot stays valid after a new one was applied.
+  storage->ApplySnapshot(PBSnapshot().MetaIndex(5).MetaTerm(5).v);
+  ASSERT_EQ(s1->metadata().index(), 4);
+  ASSERT_EQ(storage->Snapshot().GetValue()->metadata().index(), 5);
+}
+
+TEST_F(MemoryStorageTest, CreateSnapshot) {
+  auto cs = PBSnapshot().MetaConfState({1, 2, 3}).v.metadata().conf_state();
+  std::string data("data");
+
+  struct TestData {
+    uint64_t i;
+
+    Error::ErrorCodes werr;
+    uint64_t wfirst;
+  } tests[] = {{2, Error::LogCompacted, 4},
+               {4, Error::OK, 5},
+               {5, Error::OK, 6},
+               {6, Error::OutOfBound, 4}};
+
+  for (auto t : tests) {
+    MemStoreUptr storage(new MemoryStorage());
+    storage->TEST_Entries().clear();
+    storage->TEST_Entries() << pbEntry(3, 3) << pbEntry(4, 4) << pbEntry(5, 5);
+
+    auto future = storage->CreateSnapshot(t.i, cs, [&]() { return data; });
+    ASSERT_EQ(future.get().Code(), t.werr);
+    ASSERT_EQ(storage->FirstIndex().GetValue(), t.wfirst);
+
+    if (t.werr == Error::OK) {
+      auto snap = storage->Snapshot().GetValue();
+      ASSERT_EQ(snap->metadata().index(), t.i);
+      ASSERT_EQ(snap->metadata().term(), t.i);
+      ASSERT_EQ(snap->metadata().conf_state().nodes_size(), 3);
+      ASSERT_EQ(snap->data(), data);
+    }
+  }
+}
+
+// Ensure the log stays accessible while the snapshot data is being produced, and
+// a snapshot overtaken by a newer one is not installed.
+TEST_F(MemoryStorageTest, CreateSnapshotInBackground) {
+  MemStoreUptr storage(new MemoryStorage());
+  storage->TEST_Entries().clear();
+  storage->TEST_Entries() << pbEntry(3, 3) << pbEntry(4, 4) << pbEntry(5, 5);
+
+  std::promise<void> started, resume;
+  auto future = storage->CreateSnapshot(4, pb::ConfState(), [&]() {
+    started.set_value();
+    resume.get_future().wait();
+    return std::string("data");
+  });
+  started.get_future().wait();
+
+  ASSERT_EQ(storage->CreateSnapshot(5, pb::ConfState(), []() { return std::string(); })
+                .get()
+                .Code(),
+            Error::SnapshotUnavailable);
+
+  storage->Append(pbEntry(6, 6));
+  ASSERT_EQ(storage->LastIndex().GetValue(), 6);
+  ASSERT_EQ(storage->Term(4).GetValue(), 4);
+
+  storage->ApplySnapshot(PBSnapshot().MetaIndex(5).MetaTerm(5).v);
+  resume.set_value();
+
+  ASSERT_EQ(future.get().Code(), Error::SnapshotOutOfDate);
+  ASSERT_EQ(storage->Snapshot().GetValue()->metadata().index(), 5);
+}
+
+// Ensure an exception thrown by the producer reaches the future, and doesn't
+// block the following creations.
+TEST_F(MemoryStorageTest, CreateSnapshotProducerThrows) {
+  MemStoreUptr storage(new MemoryStorage());
+  storage->TEST_Entries().clear();
+  storage->TEST_Entries() << pbEntry(3, 3) << pbEntry(4, 4) << pbEntry(5, 5);
+
+  auto future = storage->CreateSnapshot(
+      4, pb::ConfState(), []() -> std::string { throw std::runtime_error("producer"); });
+  ASSERT_THROW(future.get(), std::runtime_error);
+  ASSERT_EQ(storage->FirstIndex().GetValue(), 4);
+
+  future = storage->CreateSnapshot(4, pb::ConfState(), []() { return std::string("data"); });
+  ASSERT_OK(future.get());
+  ASSERT_EQ(storage->FirstIndex().GetValue(), 5);
+}
@@ -0,0 +1,156 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_encoder.h"
+
+#include <algorithm>
+
+namespace yaraft {
+
+namespace {
+
+// wire type 2 (length-delimited) tags.
+const char kBatchMessagesTag = (pb::MessageBatch::kMessagesFieldNumber << 3) | 2;
+const char kMessageEntriesTag = (pb::Message::kEntriesFieldNumber << 3) | 2;
+const char kMessageSnapshotTag = (pb::Message::kSnapshotFieldNumber << 3) | 2;
+
+void appendVarint(uint64_t v, std::string* out) {
+  while (v >= 0x80) {
+    out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out->push_back(static_cast<char>(v));
+}
+
+size_t varintSize(uint64_t v) {
+  size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+}  // namespace
+
+MessageEncoder::MessageEncoder(size_t capacity)
+    : slots_(std::max<size_t>(capacity, 1)), encodes_(0) {
+  for (auto& s : slots_) {
+    s.index = s.term = 0;
+  }
+}
+
+MessageEncoder::EncodedSnapshots MessageEncoder::EncodeSnapshots(
+    const std::vector<pb::MessageBatch>& batches, const MsgSnapshots& snaps) {
+  EncodedSnapshots encoded;
+  if (snaps.empty()) {
+    return encoded;
+  }
+  for (const auto& b : batches) {
+    for (const auto& m : b.messages()) {
+      if (m.type() != pb::MsgSnap) {
+        continue;
+      }
+      uint64_t index = m.snapshot().metadata().index();
+      auto it = snaps.find(index);
+      if (it != snaps.end() && encoded.find(index) == encoded.end()) {
+        it->second->SerializeToString(&encoded[index]);
+      }
+    }
+  }
+  return encoded;
+}
+
+void MessageEncoder::AppendBatch(pb::MessageBatch* batch, const EncodedSnapshots& snaps,
+                                 std::string* out) {
+  for (auto& m : *batch->mutable_messages()) {
+    if (m.type() == pb::MsgSnap) {
+      auto it = snaps.find(m.snapshot().metadata().index());
+      if (it != snaps.end()) {
+        appendSnapshot(&m, it->second, out);
+        continue;
+      }
+    }
+    appendMessage(&m, out);
+  }
+}
+
+void MessageEncoder::appendSnapshot(pb::Message* m, const std::string& image, std::string* out) {
+  // the header is the message without its snapshot metadata, the image
+  // replaces it.
+  pb::Snapshot* meta = m->release_snapshot();
+  std::string header = m->SerializeAsString();
+  m->set_allocated_snapshot(meta);
+
+  size_t size = header.size() + 1 + varintSize(image.size()) + image.size();
+  out->push_back(kBatchMessagesTag);
+  appendVarint(size, out);
+  out->append(header);
+  out->push_back(kMessageSnapshotTag);
+  appendVarint(image.size(), out);
+  out->append(image);
+}
+
+void MessageEncoder::appendMessage(pb::Message* m, std::string* out) {
+  // the cache can't hold all the entries of a message larger than it. Only the
+  // entries of MsgApps are cached, the ones of a forwarded MsgProp have no index
+  // and term yet.
+  auto n = static_cast<size_t>(m->entries_size());
+  if (n == 0 || n > slots_.size() || m->type() != pb::MsgApp || m->entries(0).index() == 0) {
+    encodes_ += n;
+    out->push_back(kBatchMessagesTag);
+    appendVarint(static_cast<uint64_t>(m->ByteSize()), out);
+    m->AppendToString(out);
+    return;
+  }
+
+  // Protobuf parsers accept fields in any order, so the message is encoded as
+  // its header (all the fields but entries) followed by the entries.
+  google::protobuf::RepeatedPtrField<pb::Entry> entries;
+  entries.Swap(m->mutable_entries());
+  std::string header = m->SerializeAsString();
+
+  std::vector<const std::string*> encoded;
+  encoded.reserve(n);
+  size_t size = header.size();
+  for (const auto& e : entries) {
+    const std::string* bytes = &encodeEntry(e);
+    encoded.push_back(bytes);
+    size += 1 + varintSize(bytes->size()) + bytes->size();
+  }
+  entries.Swap(m->mutable_entries());
+
+  out->push_back(kBatchMessagesTag);
+  appendVarint(size, out);
+  out->append(header);
+  for (const std::string* bytes : encoded) {
+    out->push_back(kMessageEntriesTag);
+    appendVarint(bytes->size(), out);
+    out->append(*bytes);
+  }
+}
+
+const std::string& MessageEncoder::encodeEntry(const pb::Entry& e) {
+  Slot& s = slots_[e.index() % slots_.size()];
+  if (s.index != e.index() || s.term != e.term() || s.bytes.empty()) {
+    s.index = e.index();
+    s.term = e.term();
+    s.bytes.clear();
+    e.AppendToString(&s.bytes);
+    encodes_++;
+  }
+  return s.bytes;
+}
+
+}  // namespace yaraft
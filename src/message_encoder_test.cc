@@ -0,0 +1,153 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_encoder.h"
+#include "test_utils.h"
+
+using namespace yaraft;
+
+class MessageEncoderTest : public BaseTest {};
+
+namespace {
+
+pb::Message newMsgApp(uint64_t to, uint64_t lo, uint64_t hi) {
+  EntryVec ents;
+  for (uint64_t i = lo; i < hi; i++) {
+    ents.push_back(PBEntry().Index(i).Term(1).Data("data" + std::to_string(i)).v);
+  }
+  return PBMessage()
+      .From(1)
+      .To(to)
+      .Type(pb::MsgApp)
+      .Term(1)
+      .Index(lo - 1)
+      .LogTerm(1)
+      .Commit(lo)
+      .Entries(ents)
+      .v;
+}
+
+}  // namespace
+
+// This test ensures the encoding of a batch parses back to the batch.
+TEST_F(MessageEncoderTest, RoundTrip) {
+  pb::MessageBatch batch;
+  *batch.add_messages() = newMsgApp(2, 1, 5);
+  *batch.add_messages() = PBMessage().From(1).To(2).Type(pb::MsgHeartbeat).Term(1).Commit(3).v;
+  *batch.add_messages() = newMsgApp(2, 5, 6);
+  std::string expected = batch.SerializeAsString();
+
+  MessageEncoder encoder;
+  std::string out;
+  encoder.AppendBatch(&batch, &out);
+  ASSERT_EQ(batch.SerializeAsString(), expected);
+
+  pb::MessageBatch parsed;
+  ASSERT_TRUE(parsed.ParseFromString(out));
+  ASSERT_EQ(parsed.SerializeAsString(), expected);
+  ASSERT_EQ(encoder.Encodes(), 5);
+}
+
+// This test ensures that the entries sent to several followers are encoded
+// only once.
+TEST_F(MessageEncoderTest, FanOut) {
+  MessageEncoder encoder;
+  for (uint64_t to = 2; to <= 5; to++) {
+    pb::MessageBatch batch;
+    *batch.add_messages() = newMsgApp(to, 1, 101);
+    std::string out;
+    encoder.AppendBatch(&batch, &out);
+
+    pb::MessageBatch parsed;
+    ASSERT_TRUE(parsed.ParseFromString(out));
+    ASSERT_EQ(parsed.SerializeAsString(), batch.SerializeAsString());
+  }
+  ASSERT_EQ(encoder.Encodes(), 100);
+
+  // an entry overwritten by a new leader is encoded again.
+  pb::MessageBatch batch;
+  auto m = newMsgApp(2, 100, 101);
+  m.mutable_entries(0)->set_term(2);
+  *batch.add_messages() = m;
+  std::string out;
+  encoder.AppendBatch(&batch, &out);
+  ASSERT_EQ(encoder.Encodes(), 101);
+}
+
+// This test ensures a message with more entries than the capacity of the
+// encoder is encoded correctly.
+TEST_F(MessageEncoderTest, LargerThanCapacity) {
+  MessageEncoder encoder(8);
+  pb::MessageBatch batch;
+  *batch.add_messages() = newMsgApp(2, 1, 21);
+  std::string out;
+  encoder.AppendBatch(&batch, &out);
+
+  pb::MessageBatch parsed;
+  ASSERT_TRUE(parsed.ParseFromString(out));
+  ASSERT_EQ(parsed.SerializeAsString(), batch.SerializeAsString());
+}
+
+// This test ensures that the forwarded proposals, whose entries have neither
+// index nor term, are not served from the cache.
+TEST_F(MessageEncoderTest, ForwardedProposals) {
+  MessageEncoder encoder;
+  for (const std::string data : {"first", "second"}) {
+    pb::MessageBatch batch;
+    *batch.add_messages() =
+        PBMessage().From(2).To(1).Type(pb::MsgProp).Entries({PBEntry().Data(data).v}).v;
+    std::string out;
+    encoder.AppendBatch(&batch, &out);
+
+    pb::MessageBatch parsed;
+    ASSERT_TRUE(parsed.ParseFromString(out));
+    ASSERT_EQ(parsed.messages(0).entries(0).data(), data);
+  }
+  ASSERT_EQ(encoder.Encodes(), 2);
+}
+
+// This test ensures that the image of a snapshot sent to several followers is
+// encoded only once, and that the MsgSnaps parse with the image.
+TEST_F(MessageEncoderTest, SnapshotFanOut) {
+  auto image = PBSnapshot().MetaIndex(10).MetaTerm(2).MetaConfState({1, 2, 3}).v;
+  image.set_data(std::string(4096, 'x'));
+  MsgSnapshots snaps;
+  snaps[10].reset(new pb::Snapshot(image));
+
+  std::vector<pb::MessageBatch> batches(2);
+  for (uint64_t to = 2; to <= 3; to++) {
+    auto& batch = batches[to - 2];
+    auto m = PBMessage().From(1).To(to).Type(pb::MsgSnap).Term(2).v;
+    m.mutable_snapshot()->mutable_metadata()->CopyFrom(image.metadata());
+    *batch.add_messages() = m;
+    *batch.add_messages() = PBMessage().From(1).To(to).Type(pb::MsgHeartbeat).Term(2).v;
+  }
+  auto encoded = MessageEncoder::EncodeSnapshots(batches, snaps);
+  ASSERT_EQ(encoded.size(), 1);
+
+  MessageEncoder encoder;
+  for (uint64_t to = 2; to <= 3; to++) {
+    auto& batch = batches[to - 2];
+    std::string out;
+    encoder.AppendBatch(&batch, encoded, &out);
+    ASSERT_FALSE(batch.messages(0).snapshot().has_data());
+
+    pb::MessageBatch parsed;
+    ASSERT_TRUE(parsed.ParseFromString(out));
+    ASSERT_EQ(parsed.messages_size(), 2);
+    ASSERT_EQ(parsed.messages(0).to(), to);
+    ASSERT_EQ(parsed.messages(0).snapshot().SerializeAsString(), image.SerializeAsString());
+    ASSERT_EQ(parsed.messages(1).type(), pb::MsgHeartbeat);
+  }
+}
@@ -38,3 +38,25 @@ TEST(Util, IsLocalMessage) {
     ASSERT_EQ(IsLocalMessage(t.msgt), t.isLocal);
   }
 }
+
+// ConfChange::Voters must survive Swap, copying and serialization.
+TEST(Util, ConfChangeVoters) {
+  pb::ConfChange cc;
+  cc.set_type(pb::ConfChangeBeginJoint);
+  for (uint64_t id : {1, 2, 3}) {
+    cc.add_voters(id);
+  }
+
+  pb::ConfChange swapped;
+  swapped.Swap(&cc);
+  ASSERT_EQ(swapped.voters_size(), 3);
+  ASSERT_EQ(cc.voters_size(), 0);
+
+  pb::ConfChange copied(swapped);
+  ASSERT_EQ(copied.voters_size(), 3);
+
+  pb::ConfChange parsed;
+  ASSERT_TRUE(parsed.ParseFromString(swapped.SerializeAsString()));
+  ASSERT_EQ(parsed.voters_size(), 3);
+  ASSERT_EQ(parsed.voters(2), 3);
+}
@@ -20,6 +20,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <fmt/format.h>
 
@@ -82,6 +84,18 @@ class Progress {
     return *this;
   }
 
+  // AppResps is the number of MsgAppResps received from the follower since the
+  // progress was reset. Compared with MatchIndex, it shows how many entries are
+  // acknowledged by each response.
+  uint64_t AppResps() const {
+    return appResps_;
+  }
+
+  Progress& AppResps(uint64_t n) {
+    appResps_ = n;
+    return *this;
+  }
+
   // IsPaused returns whether sending log entries to this node has been
   // paused. A node may be paused because it has rejected recent
   // MsgApps, is currently waiting for a snapshot, or has reached the
@@ -108,8 +122,10 @@ class Progress {
     return state_ == StateSnapshot && match_ >= pendingSnapshot_;
   }
 
-  // MaybeDecrTo returns true if nextIndex is decremented.
-  bool MaybeDecrTo(uint64_t rejected, uint64_t lastIndex) {
+  // MaybeDecrTo returns true if nextIndex is decremented. `matchHint` is the
+  // largest index that may match on the follower, the next probe starts right
+  // after it.
+  bool MaybeDecrTo(uint64_t rejected, uint64_t matchHint) {
     if (state_ == StateReplicate) {
       // the rejection must be stale if the progress has matched and "rejected"
       // is smaller than "match".
@@ -126,7 +142,7 @@ class Progress {
       return false;
     }
 
-    next_ = std::min(rejected, lastIndex + 1);
+    next_ = std::min(rejected, matchHint + 1);
     if (next_ < 1) {
       next_ = 1;
     }
@@ -214,6 +230,8 @@ class Progress {
 
   uint64_t pendingSnapshot_;
 
+  uint64_t appResps_ = 0;
+
   // inflights is a sliding window for the inflight messages.
   // Each inflight message contains one or more log entries.
   // The max number of entries per message is defined in raft config as maxSizePerMsg.
@@ -229,4 +247,172 @@ class Progress {
   std::vector<uint64_t> ins_;
 };
 
+// ProgressTracker maps the peer ids to their progresses. It's a replacement of
+// std::unordered_map<uint64_t, Progress> for the small number of peers in a
+// raft group: the progresses are stored contiguously, and looked up by a
+// linear scan over the slots, which is faster than hashing for a few peers.
+//
+// A peer keeps its slot until it's erased, and the freed slot is reused by the
+// next insertion, so the iteration order is stable. Insertions may invalidate
+// the references and iterators, erasures don't.
+class ProgressTracker {
+ public:
+  using value_type = std::pair<uint64_t, Progress>;
+
+ private:
+  // id 0 is never used by raft, it marks a free slot.
+  static const uint64_t kFreeSlot = 0;
+
+  template <typename Slots, typename Value>
+  class Iterator {
+   public:
+    Iterator(Slots* slots, size_t i) : slots_(slots), i_(i) {
+      skipFree();
+    }
+
+    Value& operator*() const {
+      return (*slots_)[i_];
+    }
+
+    Value* operator->() const {
+      return &(*slots_)[i_];
+    }
+
+    Iterator& operator++() {
+      i_++;
+      skipFree();
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return i_ == other.i_;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return i_ != other.i_;
+    }
+
+   private:
+    friend class ProgressTracker;
+
+    void skipFree() {
+      while (i_ < slots_->size() && (*slots_)[i_].first == kFreeSlot) {
+        i_++;
+      }
+    }
+
+    Slots* slots_;
+    size_t i_;
+  };
+
+ public:
+  using iterator = Iterator<std::vector<value_type>, value_type>;
+  using const_iterator = Iterator<const std::vector<value_type>, const value_type>;
+
+  iterator begin() {
+    return iterator(&slots_, 0);
+  }
+
+  iterator end() {
+    return iterator(&slots_, slots_.size());
+  }
+
+  const_iterator begin() const {
+    return const_iterator(&slots_, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(&slots_, slots_.size());
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  iterator find(uint64_t id) {
+    return iterator(&slots_, slotOf(id));
+  }
+
+  const_iterator find(uint64_t id) const {
+    return const_iterator(&slots_, slotOf(id));
+  }
+
+  // at returns the progress of `id`, which must exist.
+  Progress& at(uint64_t id) {
+    size_t i = slotOf(id);
+    if (i >= slots_.size()) {
+      FMT_LOG(FATAL, "no progress available for {:x}", id);
+    }
+    return slots_[i].second;
+  }
+
+  const Progress& at(uint64_t id) const {
+    size_t i = slotOf(id);
+    if (i >= slots_.size()) {
+      FMT_LOG(FATAL, "no progress available for {:x}", id);
+    }
+    return slots_[i].second;
+  }
+
+  // operator[] returns the progress of `id`, inserts a default one if there's
+  // none.
+  Progress& operator[](uint64_t id) {
+    DLOG_ASSERT(id != kFreeSlot);
+    size_t i = slotOf(id);
+    if (i < slots_.size()) {
+      return slots_[i].second;
+    }
+
+    size_++;
+    for (auto& slot : slots_) {
+      if (slot.first == kFreeSlot) {
+        slot.first = id;
+        slot.second = Progress();
+        return slot.second;
+      }
+    }
+    slots_.emplace_back(id, Progress());
+    return slots_.back().second;
+  }
+
+  void erase(iterator it) {
+    it->first = kFreeSlot;
+    it->second = Progress();
+    size_--;
+  }
+
+  void erase(uint64_t id) {
+    auto it = find(id);
+    if (it != end()) {
+      erase(it);
+    }
+  }
+
+  void clear() {
+    slots_.clear();
+    size_ = 0;
+  }
+
+ private:
+  // slotOf returns the slot of `id`, or slots_.size() if there's none.
+  size_t slotOf(uint64_t id) const {
+    if (id == kFreeSlot) {
+      return slots_.size();
+    }
+    size_t i = 0;
+    while (i < slots_.size() && slots_[i].first != id) {
+      i++;
+    }
+    return i;
+  }
+
+ private:
+  std::vector<value_type> slots_;
+  size_t size_ = 0;
+};
+
 }  // namespace yaraft
@@ -175,4 +175,37 @@ TEST(Progress, Update) {
     ASSERT_EQ(p.MatchIndex(), tt.wm);
     ASSERT_EQ(p.NextIndex(), tt.wn);
   }
-}
\ No newline at end of file
+}
+
+TEST(ProgressTracker, InsertEraseFind) {
+  ProgressTracker prs;
+  for (uint64_t id = 1; id <= 3; id++) {
+    prs[id].MatchIndex(id);
+  }
+  ASSERT_EQ(prs.size(), 3);
+  ASSERT_EQ(prs.at(2).MatchIndex(), 2);
+  ASSERT_TRUE(prs.find(4) == prs.end());
+  ASSERT_TRUE(prs.find(0) == prs.end());
+
+  // the slot of 2 is reused by 4, the others keep theirs.
+  Progress* pr3 = &prs.at(3);
+  prs.erase(2);
+  ASSERT_EQ(prs.size(), 2);
+  ASSERT_TRUE(prs.find(2) == prs.end());
+  ASSERT_EQ(&prs.at(3), pr3);
+  prs[4].MatchIndex(4);
+  ASSERT_EQ(&prs.at(3), pr3);
+
+  std::vector<uint64_t> ids;
+  for (auto& e : prs) {
+    ids.push_back(e.first);
+    ASSERT_EQ(e.second.MatchIndex(), e.first);
+  }
+  ASSERT_EQ(ids, std::vector<uint64_t>({1, 4, 3}));
+
+  prs.erase(prs.find(1));
+  prs.erase(4);
+  prs.erase(3);
+  ASSERT_TRUE(prs.empty());
+  ASSERT_TRUE(prs.begin() == prs.end());
+}
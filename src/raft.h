@@ -17,8 +17,8 @@
 
 #include <chrono>
 #include <cstdint>
+#include <map>
 #include <memory>
-#include <random>
 #include <unordered_map>
 
 #include "conf.h"
@@ -32,6 +32,11 @@
 
 namespace yaraft {
 
+// kCampaignTransferCtx is attached as the context of MsgVote when the election is
+// triggered by a leader transfer, so that the voters won't reject it because of
+// the leader lease.
+static const char* const kCampaignTransferCtx = "CampaignTransfer";
+
 inline pb::MessageType voteRespType(pb::MessageType voteType) {
   return voteType == pb::MsgVote ? pb::MsgVoteResp : pb::MsgPreVoteResp;
 }
@@ -45,6 +50,9 @@ class Raft {
     // kCampaignPreElection represents the first phase of a normal election when
     // Config.PreVote is true.
     kCampaignPreElection,
+
+    // kCampaignTransfer represents the type of leader transfer.
+    kCampaignTransfer,
   };
 
  public:
@@ -56,7 +64,13 @@ class Raft {
         log_(new RaftLog(conf->storage)),
         electionElapsed_(0),
         votedFor_(0),
-        pendingConf_(false) {
+        pendingConf_(false),
+        leadTransferee_(0),
+        lastReadRequestId_(0),
+        ticks_(0),
+        randomState_(initRandomState(*conf)),
+        deferCommit_(false),
+        commitDeferred_(false) {
     step_ = std::bind(&Raft::stepImpl, this, std::placeholders::_1);
 
     pb::HardState hardState;
@@ -73,6 +87,12 @@ class Raft {
     for (uint64_t p : peers) {
       prs_[p] = Progress();
     }
+    for (uint64_t p : conf->learners) {
+      if (UNLIKELY(prs_.find(p) != prs_.end())) {
+        FMT_SLOG(FATAL, "node %x is in both learner and peer list", p);
+      }
+      learnerPrs_[p] = Progress();
+    }
 
     std::string nodeStr = std::to_string(*peers.begin());
     std::for_each(std::next(peers.begin()), peers.end(),
@@ -89,11 +109,46 @@ class Raft {
     if (m.term() == 0) {
       // local message
     } else if (currentTerm_ > m.term()) {
-      // ignore the message
-      FMT_SLOG(INFO, "%x [term: %d] ignored a %s message with lower term from %x [term: %d]", id_,
-               currentTerm_, pb::MessageType_Name(m.type()), m.from(), m.term());
+      if (c_->checkQuorum && (m.type() == pb::MsgHeartbeat || m.type() == pb::MsgApp)) {
+        // We have received messages from a leader at a lower term. It is possible
+        // that these messages were simply delayed in the network, but this could
+        // also mean that this node has advanced its term number during a network
+        // partition, and it is now unable to either win an election or to rejoin
+        // the majority on the old term. If checkQuorum is false, this will be
+        // handled by incrementing term numbers in response to MsgVote with a
+        // higher term, but if checkQuorum is true we may not advance the term on
+        // MsgVote and must generate other messages to advance the term. The net
+        // result of these two features is to minimize the disruption caused by
+        // nodes that have been removed from the cluster's configuration: a
+        // removed node will send MsgVotes which will be ignored, but it will not
+        // receive MsgApp or MsgHeartbeat, so it will not create disruptive term
+        // increases.
+        send(PBMessage().To(m.from()).Type(pb::MsgAppResp).v);
+      } else {
+        // ignore the message
+        FMT_SLOG(INFO, "%x [term: %d] ignored a %s message with lower term from %x [term: %d]",
+                 id_, currentTerm_, pb::MessageType_Name(m.type()), m.from(), m.term());
+      }
       return Status::OK();
     } else if (currentTerm_ < m.term()) {
+      if (m.type() == pb::MsgVote || m.type() == pb::MsgPreVote) {
+        bool force = m.context() == kCampaignTransferCtx;
+        bool inLease =
+            c_->checkQuorum && currentLeader_ != 0 && electionElapsed_ < c_->electionTick;
+        if (!force && inLease) {
+          // If a server receives a RequestVote request within the minimum election timeout
+          // of hearing from a current leader, it does not update its term or grant its vote
+          // (raft thesis 4.2.3).
+          FMT_SLOG(INFO,
+                   "%x [logterm: %d, index: %d, vote: %x] ignored %s from %x [logterm: %d, index: "
+                   "%d] at term %d: lease is not expired (remaining ticks: %d)",
+                   id_, log_->LastTerm(), log_->LastIndex(), votedFor_,
+                   pb::MessageType_Name(m.type()), m.from(), m.logterm(), m.index(), currentTerm_,
+                   c_->electionTick - electionElapsed_);
+          return Status::OK();
+        }
+      }
+
       if (m.type() == pb::MsgPreVote) {
         // currentTerm never changes when receiving a PreVote.
       } else if (m.type() == pb::MsgPreVoteResp && !m.reject()) {
@@ -118,6 +173,10 @@ class Raft {
     switch (m.type()) {
       case pb::MsgHup:
         DLOG_ASSERT(role_ != kLeader);
+        if (!promotable()) {
+          FMT_SLOG(WARNING, "%x is a learner and cannot campaign at term %d", id_, currentTerm_);
+          break;
+        }
         FMT_SLOG(INFO, "%x is starting a new election at term %d", id_, currentTerm_);
         if (c_->preVote) {
           campaign(kCampaignPreElection);
@@ -126,10 +185,18 @@ class Raft {
         }
         break;
       case pb::MsgVote:
-        handleMsgVote(m);
-        break;
       case pb::MsgPreVote:
-        handleMsgPreVote(m);
+        if (IsLearner()) {
+          FMT_SLOG(INFO,
+                   "%x [logterm: %d, index: %d, vote: %x] ignored %s from %x [logterm: %d, index: "
+                   "%d] at term %d: learner can not vote",
+                   id_, log_->LastTerm(), log_->LastIndex(), votedFor_,
+                   pb::MessageType_Name(m.type()), m.from(), m.logterm(), m.index(), currentTerm_);
+        } else if (m.type() == pb::MsgVote) {
+          handleMsgVote(m);
+        } else {
+          handleMsgPreVote(m);
+        }
         break;
       default:
         step_(m);
@@ -141,6 +208,26 @@ class Raft {
     return currentTerm_;
   }
 
+  // DeferCommit makes the leader hold off advancing the commit index on
+  // MsgAppResp until FlushCommit, so that a run of responses advances it and
+  // broadcasts the appends only once. Turning it off flushes.
+  void DeferCommit(bool defer) {
+    deferCommit_ = defer;
+    if (!defer) {
+      FlushCommit();
+    }
+  }
+
+  // FlushCommit advances the commit index deferred by DeferCommit.
+  void FlushCommit() {
+    if (commitDeferred_) {
+      commitDeferred_ = false;
+      if (role_ == kLeader && maybeCommit()) {
+        bcastAppend();
+      }
+    }
+  }
+
   uint64_t Id() const {
     return id_;
   }
@@ -164,6 +251,14 @@ class Raft {
     return (prs_.find(id) != prs_.end());
   }
 
+  bool HasLearner(uint64_t id) const {
+    return (learnerPrs_.find(id) != learnerPrs_.end());
+  }
+
+  bool IsLearner() const {
+    return HasLearner(id_);
+  }
+
   std::set<uint64_t> Peers() const {
     std::set<uint64_t> peers;
     for (auto& e : prs_) {
@@ -172,7 +267,16 @@ class Raft {
     return peers;
   }
 
+  std::set<uint64_t> Learners() const {
+    std::set<uint64_t> learners;
+    for (auto& e : learnerPrs_) {
+      learners.insert(e.first);
+    }
+    return learners;
+  }
+
   // call this function when a new ConfChangeAddNode has applied.
+  // A learner is promoted to voter with its replication progress kept.
   void AddNode(uint64_t nodeId) {
     pendingConf_ = false;
 
@@ -182,17 +286,153 @@ class Raft {
       return;
     }
 
+    auto it = learnerPrs_.find(nodeId);
+    if (it != learnerPrs_.end()) {
+      prs_[nodeId] = it->second;
+      learnerPrs_.erase(it);
+      FMT_SLOG(INFO, "%x promoted learner %x to voter", id_, nodeId);
+      return;
+    }
+
     prs_[nodeId] = Progress().MatchIndex(0).NextIndex(log_->LastIndex() + 1);
   }
 
+  // call this function when a new ConfChangeAddLearnerNode has applied.
+  void AddLearner(uint64_t nodeId) {
+    pendingConf_ = false;
+
+    if (learnerPrs_.find(nodeId) != learnerPrs_.end()) {
+      return;
+    }
+
+    if (prs_.find(nodeId) != prs_.end()) {
+      FMT_SLOG(WARNING, "%x ignored demoting voter %x to learner", id_, nodeId);
+      return;
+    }
+
+    learnerPrs_[nodeId] = Progress().MatchIndex(0).NextIndex(log_->LastIndex() + 1);
+  }
+
   void RemoveNode(uint64_t nodeId) {
     pendingConf_ = false;
 
     if (prs_.find(nodeId) != prs_.end()) {
       prs_.erase(nodeId);
+      readOnly_.RemovePeer(nodeId);
+    }
+    learnerPrs_.erase(nodeId);
+
+    // do not try to transfer leadership to the removed node.
+    if (role_ == kLeader && leadTransferee_ == nodeId) {
+      abortLeaderTransfer();
+    }
+  }
+
+  // call this function when a new ConfChangeBeginJoint has applied.
+  // `voters` is the voter set of the new configuration. Until the joint
+  // configuration is left, elections and commitment require separate majorities
+  // from both the old and the new voters (raft thesis 4.3).
+  void EnterJoint(const std::vector<uint64_t>& voters) {
+    pendingConf_ = false;
+
+    if (IsJoint()) {
+      FMT_SLOG(WARNING, "%x ignored entering joint configuration since it's already joint", id_);
+      return;
+    }
+    if (voters.empty()) {
+      FMT_SLOG(WARNING, "%x ignored entering joint configuration with no voters", id_);
+      return;
+    }
+
+    outgoing_ = Peers();
+    incoming_ = std::set<uint64_t>(voters.begin(), voters.end());
+    for (uint64_t id : incoming_) {
+      if (prs_.find(id) != prs_.end()) {
+        continue;
+      }
+      auto it = learnerPrs_.find(id);
+      if (it != learnerPrs_.end()) {
+        prs_[id] = it->second;
+        learnerPrs_.erase(it);
+      } else {
+        prs_[id] = Progress().MatchIndex(0).NextIndex(log_->LastIndex() + 1);
+      }
+    }
+    FMT_SLOG(INFO, "%x entered joint configuration [incoming: %d voters, outgoing: %d voters]",
+             id_, incoming_.size(), outgoing_.size());
+
+    maybeLeaveJoint();
+  }
+
+  // call this function when a new ConfChangeLeaveJoint has applied.
+  // The voters that are not in the new configuration are removed.
+  void LeaveJoint() {
+    pendingConf_ = false;
+
+    if (!IsJoint()) {
+      return;
+    }
+
+    for (uint64_t id : outgoing_) {
+      if (incoming_.find(id) == incoming_.end()) {
+        prs_.erase(id);
+        readOnly_.RemovePeer(id);
+      }
+    }
+    incoming_.clear();
+    outgoing_.clear();
+    FMT_SLOG(INFO, "%x left joint configuration", id_);
+
+    // a leader that is not part of the new configuration steps down
+    // once the new configuration is committed (raft thesis 4.2.2).
+    if (role_ == kLeader && prs_.find(id_) == prs_.end()) {
+      becomeFollower(currentTerm_, 0);
     }
   }
 
+  bool IsJoint() const {
+    return !outgoing_.empty();
+  }
+
+  // CheckConfChange returns an error if `cc` can't be applied to the current
+  // configuration.
+  Status CheckConfChange(const pb::ConfChange& cc) const {
+    if (IsJoint() && cc.type() != pb::ConfChangeLeaveJoint) {
+      // the voters of a joint configuration only change by leaving it.
+      return Status::Make(Error::InvalidConfig, "the configuration is joint");
+    }
+
+    size_t voters = prs_.size();
+    if (cc.type() == pb::ConfChangeAddNode && !HasPeer(cc.nodeid())) {
+      voters++;
+    } else if (cc.type() == pb::ConfChangeBeginJoint) {
+      for (uint64_t id : std::set<uint64_t>(cc.voters().begin(), cc.voters().end())) {
+        voters += HasPeer(id) ? 0 : 1;
+      }
+    }
+    if (voters > kMaxVoters) {
+      return Status::Make(Error::InvalidConfig,
+                          fmt::format("a raft group has at most {} voters", kMaxVoters));
+    }
+    return Status::OK();
+  }
+
+  // CurrentConfState returns the membership of the raft group. During a joint
+  // consensus, nodes are the voters of the incoming configuration.
+  pb::ConfState CurrentConfState() const {
+    pb::ConfState cs;
+    for (uint64_t id : (IsJoint() ? incoming_ : Peers())) {
+      cs.add_nodes(id);
+    }
+    for (uint64_t id : outgoing_) {
+      cs.add_nodes_outgoing(id);
+    }
+    for (uint64_t id : Learners()) {
+      cs.add_learners(id);
+    }
+    return cs;
+  }
+
  private:
   void becomeFollower(uint64_t term, uint64_t lead) {
     role_ = kFollower;
@@ -201,6 +441,8 @@ class Raft {
 
     votedFor_ = 0;
     resetRandomizedElectionTimeout();
+    abortLeaderTransfer();
+    resetReadOnly();
 
     FMT_SLOG(INFO, "%x became follower at term %d", id_, currentTerm_);
   }
@@ -208,6 +450,7 @@ class Raft {
   void becomePreCandidate() {
     role_ = kPreCandidate;
     currentLeader_ = 0;
+    abortLeaderTransfer();
 
     // Becoming a pre-candidate changes our state,
     // but doesn't change anything else. In particular it does not increase
@@ -232,21 +475,13 @@ class Raft {
     currentTerm_++;
     currentLeader_ = 0;
     resetRandomizedElectionTimeout();
+    abortLeaderTransfer();
+    resetReadOnly();
   }
 
   // number of uncommitted conf change entries
   size_t numOfPendingConf() {
-    auto s = log_->Entries(log_->CommitIndex() + 1, UINT64_MAX);
-    FATAL_NOT_OK(s, "Log::Entries");
-    EntryVec& ents = s.GetValue();
-
-    size_t n = 0;
-    for (auto& e : ents) {
-      if (e.type() == pb::EntryConfChange) {
-        n++;
-      }
-    }
-    return n;
+    return log_->PendingConfChanges();
   }
 
   void becomeLeader() {
@@ -261,6 +496,9 @@ class Raft {
     role_ = kLeader;
     currentLeader_ = id_;
     heartbeatElapsed_ = 0;
+    electionElapsed_ = 0;
+    abortLeaderTransfer();
+    resetReadOnly();
 
     size_t nconf = numOfPendingConf();
     if (nconf > 1) {
@@ -274,11 +512,10 @@ class Raft {
       pendingConf_ = true;
     }
 
-    prs_.clear();
-    for (uint64_t id : c_->peers) {
-      prs_[id] = Progress().NextIndex(log_->LastIndex() + 1).MatchIndex(0);
-    }
-    prs_[id_].MatchIndex(log_->LastIndex());
+    forEachProgress([this](uint64_t /* id */, Progress& pr) {
+      pr = Progress().NextIndex(log_->LastIndex() + 1).MatchIndex(0);
+    });
+    prs_[id_].MatchIndex(log_->LastIndex()).RecentActive(true);
 
     FMT_SLOG(INFO, "%x became leader at term %d", id_, currentTerm_);
   }
@@ -288,17 +525,28 @@ class Raft {
       case pb::MsgBeat:
         bcastHeartbeat();
         return;
+      case pb::MsgCheckQuorum:
+        if (!checkQuorumActive()) {
+          FMT_SLOG(WARNING, "%x stepped down to follower since quorum is not active", id_);
+          becomeFollower(currentTerm_, 0);
+        }
+        return;
       case pb::MsgProp:
         handleMsgProp(m);
         return;
       case pb::MsgReadIndex:
         handleMsgReadIndex(m);
         return;
+      case pb::MsgTransferLeader:
+        // m.from is the transferee, which may be unknown to the leader when
+        // the request was forwarded by a follower.
+        handleMsgTransferLeader(m);
+        return;
       default:
         break;
     }
 
-    if (UNLIKELY(prs_.find(m.from()) == prs_.end())) {
+    if (UNLIKELY(getProgress(m.from()) == nullptr)) {
       FMT_SLOG(FATAL, "%x no progress available for %x", id_, m.from());
     }
 
@@ -382,10 +630,16 @@ class Raft {
     FMT_SLOG(INFO, "%x [quorum:%d] has received %d %s votes and %d vote rejections", id_, quorum(),
              gr, pb::MessageType_Name(m.type()), voteGranted_.size() - gr);
 
-    if (gr >= quorum()) {
+    auto voted = [this](uint64_t id, bool granted) {
+      auto it = voteGranted_.find(id);
+      return it != voteGranted_.end() && it->second == granted;
+    };
+
+    if (hasQuorum([&](uint64_t id) { return voted(id, true); })) {
       if (m.type() == pb::MsgVoteResp) {
         becomeLeader();
         appendRawEntries(PBMessage().Entries({PBEntry().Data(nullptr).v}).v);
+        maybeLeaveJoint();
         bcastAppend();
       } else {
         voteGranted_.clear();
@@ -394,9 +648,12 @@ class Raft {
       return;
     }
 
-    // return to follower state if it receives vote denial from a majority
-    int rejected = static_cast<int>(voteGranted_.size()) - gr;
-    if (rejected >= quorum()) {
+    // return to follower state if it receives vote denial from a majority,
+    // of either configuration during a joint consensus.
+    auto rejected = [&](uint64_t id) { return voted(id, false); };
+    bool lost = IsJoint() ? (majorityOf(incoming_, rejected) || majorityOf(outgoing_, rejected))
+                          : hasQuorum(rejected);
+    if (lost) {
       becomeFollower(m.term(), 0);
     }
   }
@@ -449,6 +706,54 @@ class Raft {
       case pb::MsgSnap:
         handleSnapshot(m);
         break;
+      case pb::MsgTransferLeader:
+        if (currentLeader_ == 0) {
+          FMT_SLOG(INFO, "%x no leader at term %d; dropping leader transfer msg", id_,
+                   currentTerm_);
+          break;
+        }
+        forwardTransferLeader(m);
+        break;
+      case pb::MsgProp:
+        if (currentLeader_ == 0) {
+          FMT_SLOG(INFO, "%x no leader at term %d; dropping proposal", id_, currentTerm_);
+          break;
+        } else if (c_->disableProposalForwarding) {
+          FMT_SLOG(INFO, "%x not forwarding to leader %x at term %d; dropping proposal", id_,
+                   currentLeader_, currentTerm_);
+          break;
+        }
+        m.clear_term();
+        m.set_to(currentLeader_);
+        send(m);
+        break;
+      case pb::MsgReadIndex:
+        if (m.from() != 0 && m.from() != id_) {
+          FMT_SLOG(INFO, "%x is not leader at term %d; dropping index reading msg from %x", id_,
+                   currentTerm_, m.from());
+          break;
+        }
+        // forwarded to the leader in batch by flushReadIndex.
+        handleMsgReadIndex(m);
+        break;
+      case pb::MsgReadIndexResp:
+        handleMsgReadIndexResp(m);
+        break;
+      case pb::MsgTimeoutNow:
+        if (promotable()) {
+          FMT_SLOG(INFO,
+                   "%x [term %d] received MsgTimeoutNow from %x and starts an election to get "
+                   "leadership.",
+                   id_, currentTerm_, m.from());
+          // Leadership transfers never use pre-vote even if Config.preVote is true; we
+          // know we are not recovering from a partition so there is no need for the
+          // extra round trip.
+          campaign(kCampaignTransfer);
+        } else {
+          FMT_SLOG(INFO, "%x received MsgTimeoutNow from %x but is not promotable", id_,
+                   m.from());
+        }
+        break;
       default:
         // ignored
         break;
@@ -483,6 +788,23 @@ class Raft {
 
   void tickHeartbeat() {
     heartbeatElapsed_++;
+    electionElapsed_++;
+
+    if (electionElapsed_ >= c_->electionTick) {
+      electionElapsed_ = 0;
+      if (c_->checkQuorum) {
+        Step(PBMessage().From(id_).Type(pb::MsgCheckQuorum).v);
+      }
+      // If current leader cannot transfer leadership in electionTimeout, it becomes leader
+      // again.
+      if (role_ == kLeader && leadTransferee_ != 0) {
+        abortLeaderTransfer();
+      }
+    }
+
+    if (role_ != kLeader) {
+      return;
+    }
 
     if (heartbeatElapsed_ >= c_->heartbeatTick) {
       heartbeatElapsed_ = 0;
@@ -492,6 +814,8 @@ class Raft {
 
   void tickElection() {
     electionElapsed_++;
+    ticks_++;
+    expireForwardedReads();
 
     if (promotable() && electionElapsed_ >= randomizedElectionTimeout_) {
       electionElapsed_ = 0;
@@ -499,8 +823,12 @@ class Raft {
     }
   }
 
+  // send queues `m` for sending. m.from is set to this node unless it's
+  // already set, see forwardTransferLeader.
   void send(pb::Message& m) {
-    m.set_from(id_);
+    if (m.from() == 0) {
+      m.set_from(id_);
+    }
 
     if (m.type() == pb::MsgVote || m.type() == pb::MsgPreVote) {
       // All {pre-,}campaign messages need to have the term set when
@@ -521,9 +849,41 @@ class Raft {
 
       m.set_term(currentTerm_);
     }
+
+    if (maybeCoalesceResp(m)) {
+      return;
+    }
     mails_.push_back(std::move(m));
   }
 
+  // A follower acks every MsgApp of a pipelined burst. Within one Ready only
+  // the highest accepted MsgAppResp to a peer is needed, since it acknowledges
+  // all the lower ones, so later responses are merged into the queued one.
+  // Likewise for the MsgHeartbeatResps that carry no read index context.
+  // Returns true if `m` has been merged.
+  bool maybeCoalesceResp(const pb::Message& m) {
+    if (m.type() == pb::MsgAppResp) {
+      if (m.reject()) {
+        return false;
+      }
+    } else if (m.type() != pb::MsgHeartbeatResp || !m.context().empty()) {
+      return false;
+    }
+
+    for (auto it = mails_.rbegin(); it != mails_.rend(); ++it) {
+      if (it->to() != m.to() || it->type() != m.type()) {
+        continue;
+      }
+      // never reorder a response across a rejection or a different term.
+      if (it->term() != m.term() || it->reject() || !it->context().empty()) {
+        return false;
+      }
+      it->set_index(std::max(it->index(), m.index()));
+      return true;
+    }
+    return false;
+  }
+
   void sendVoteResp(const pb::Message& m, bool reject) {
     if (reject) {
       FMT_SLOG(INFO,
@@ -543,31 +903,61 @@ class Raft {
     send(PBMessage().Reject(reject).To(m.from()).Type(voteRespType(m.type())).v);
   }
 
-  // promotable indicates whether state machine can be promoted to leader,
-  // which is true when its own id is in progress list.
+  // promotable indicates whether state machine can be promoted to leader.
+  // A learner, or a voter removed from the configuration, never campaigns.
   bool promotable() const {
-    return true;
+    return HasPeer(id_);
   }
 
-  void bcastHeartbeat(const std::string* ctx = nullptr) {
-    for (const auto& e : prs_) {
-      if (id_ == e.first)
-        continue;
-      sendHeartbeat(e.first, ctx);
+  // getProgress returns the progress of either a voter or a learner, or
+  // nullptr if `id` is not a member.
+  Progress* getProgress(uint64_t id) {
+    auto it = prs_.find(id);
+    if (it != prs_.end()) {
+      return &it->second;
     }
+    it = learnerPrs_.find(id);
+    if (it != learnerPrs_.end()) {
+      return &it->second;
+    }
+    return nullptr;
   }
 
-  void bcastAppend() {
-    for (const auto& e : prs_) {
-      if (id_ == e.first)
-        continue;
-      sendAppend(e.first);
+  // forEachProgress iterates over the progress of voters and learners.
+  template <typename Fn>
+  void forEachProgress(Fn&& fn) {
+    for (auto& e : prs_) {
+      fn(e.first, e.second);
+    }
+    for (auto& e : learnerPrs_) {
+      fn(e.first, e.second);
     }
   }
 
+  // Learners receive heartbeats and entries as voters do.
+  void bcastHeartbeat(const std::string* ctx = nullptr) {
+    forEachProgress([&](uint64_t id, Progress& pr) {
+      if (id != id_) {
+        sendHeartbeat(id, pr, ctx);
+      }
+    });
+  }
+
+  void bcastAppend() {
+    forEachProgress([this](uint64_t id, Progress& pr) {
+      if (id != id_) {
+        sendAppend(id, pr);
+      }
+    });
+  }
+
   // REQUIRED: `to` is an valid peer.
   void sendAppend(uint64_t to) {
-    auto& pr = prs_[to];
+    sendAppend(to, *getProgress(to));
+  }
+
+  // `pr` is the progress of `to`, which saves the lookup.
+  void sendAppend(uint64_t to, Progress& pr) {
     if (pr.IsPaused()) {
       return;
     }
@@ -577,11 +967,16 @@ class Raft {
 
     uint64_t prevLogIndex = pr.NextIndex() - 1;
     auto sTerm = log_->Term(prevLogIndex);
-    auto sEnts = log_->Entries(pr.NextIndex(), c_->maxSizePerMsg);
+    // the entries are copied from the log into the message directly.
+    Status sEnts = Status::OK();
+    if (sTerm.IsOK()) {
+      auto ents = m.v.mutable_entries();
+      sEnts = log_->ForEachEntry(pr.NextIndex(), c_->maxSizePerMsg,
+                                 [ents](const pb::Entry& e) { *ents->Add() = e; });
+    }
 
     if (sTerm.IsOK() && sEnts.IsOK()) {
       uint64_t prevLogTerm = sTerm.GetValue();
-      m.Entries(sEnts.GetValue());
       m.Type(pb::MsgApp).Index(prevLogIndex).LogTerm(prevLogTerm).Commit(log_->CommitIndex());
 
       if (!m.v.entries().empty()) {
@@ -604,14 +999,15 @@ class Raft {
       }
     } else {
       // send snapshot if we failed to get term or entries
+      m.v.clear_entries();
 
       if (!pr.RecentActive()) {
         D_FMT_SLOG(INFO, "ignore sending snapshot to %x since it is not recently active", to);
         return;
       }
 
-      pb::Snapshot snap = log_->Snapshot().GetValue();
-      if (IsEmptySnapshot(snap)) {
+      SnapshotSptr snap = log_->Snapshot().GetValue();
+      if (IsEmptySnapshot(*snap)) {
         FMT_SLOG(FATAL,
                  "%x failed to send snapshot to %x because snapshot is temporarily unavailable",
                  id_, to);
@@ -619,18 +1015,24 @@ class Raft {
 
       D_FMT_SLOG(INFO,
                  "%x [firstIndex: %d, commit: %d] sent snapshot[index: %d, term: %d] to %x [%s]",
-                 id_, log_->FirstIndex(), log_->CommitIndex(), snap.metadata().index(),
-                 snap.metadata().term(), to, pr.ToString());
+                 id_, log_->FirstIndex(), log_->CommitIndex(), snap->metadata().index(),
+                 snap->metadata().term(), to, pr.ToString());
 
-      pr.BecomeSnapshot(snap.metadata().index());
+      pr.BecomeSnapshot(snap->metadata().index());
       D_FMT_SLOG(INFO, "%x paused sending replication messages to %x [%s]", id_, to, pr.ToString());
 
-      m.Type(pb::MsgSnap).Snapshot(snap);
+      m.Type(pb::MsgSnap);
+      if (c_->detachSnapshots) {
+        m.SnapshotMetadata(snap);
+        msgSnapshots_[snap->metadata().index()] = snap;
+      } else {
+        m.Snapshot(snap);
+      }
     }
     send(m.v);
   }
 
-  void sendHeartbeat(uint64_t to, const std::string* ctx = nullptr) {
+  void sendHeartbeat(uint64_t to, const Progress& pr, const std::string* ctx = nullptr) {
     // Attach the commit as min(to.matched, raftlog.committed).
     // When the leader sends out heartbeat message,
     // the receiver(follower) might not be matched with the leader
@@ -641,7 +1043,7 @@ class Raft {
     auto m = PBMessage()
                  .To(to)
                  .Type(pb::MsgHeartbeat)
-                 .Commit(std::min(prs_[to].MatchIndex(), log_->CommitIndex()));
+                 .Commit(std::min(pr.MatchIndex(), log_->CommitIndex()));
 
     if (ctx != nullptr) {
       m.Context(new std::string(*ctx));
@@ -650,41 +1052,68 @@ class Raft {
   }
 
   void handleMsgHeartbeatResp(const pb::Message& m) {
-    auto& pr = prs_[m.from()];
+    auto& pr = *getProgress(m.from());
+    pr.RecentActive(true);
     pr.Resume();
 
     if (pr.MatchIndex() < log_->LastIndex()) {
-      sendAppend(m.from());
+      sendAppend(m.from(), pr);
+    }
+
+    // acks from learners don't count towards the quorum of a read only request.
+    if (HasLearner(m.from())) {
+      return;
     }
 
     int ackCount = readOnly_.RecvAck(m);
-    if (ackCount < quorum()) {
+    if (IsJoint()) {
+      if (ackCount == 0 ||
+          !hasQuorum([&](uint64_t id) { return id == id_ || readOnly_.Acked(m, id); })) {
+        return;
+      }
+    } else if (ackCount < quorum()) {
       return;
     }
 
-    readOnly_.Advance(m, &readStates_);
+    readOnly_.Advance(m, [this](uint64_t index, const std::vector<ReadRequest>& reqs) {
+      for (auto& req : reqs) {
+        respondReadIndex(req, index);
+      }
+    });
   }
 
   void handleMsgAppResp(const pb::Message& m) {
-    auto& pr = prs_[m.from()];
+    auto& pr = *getProgress(m.from());
     pr.RecentActive(true);
+    pr.AppResps(pr.AppResps() + 1);
 
     if (m.reject()) {
-      D_FMT_SLOG(INFO, "%x received msgApp rejection(lastindex: %d) from %x for index %d", id_,
-                 m.rejecthint(), m.from(), m.index());
-
-      if (pr.MaybeDecrTo(m.index(), m.rejecthint())) {
+      D_FMT_SLOG(INFO, "%x received msgApp rejection(hint: %d, term: %d) from %x for index %d", id_,
+                 m.rejecthint(), m.logterm(), m.from(), m.index());
+
+      // The follower's entries above the hint index can't match. Skip the
+      // leader's entries of the terms larger than the follower's term at the
+      // hint index as well, since none of them can be in the follower's log.
+      // A rejection from an older version carries no term, in which case the
+      // hint is the follower's last index.
+      uint64_t nextProbeIndex = m.rejecthint();
+      if (m.logterm() > 0) {
+        nextProbeIndex = log_->FindConflictByTerm(m.rejecthint(), m.logterm());
+      }
+      if (pr.MaybeDecrTo(m.index(), nextProbeIndex)) {
         // resume the progress, retry with a lower index.
         D_FMT_SLOG(INFO, "%x decreased progress of %x to [%s]", id_, m.from(), pr.ToString());
         pr.Resume();
         if (pr.State() == Progress::StateReplicate) {
           pr.State(Progress::StateProbe);
         }
-        sendAppend(m.from());
+        sendAppend(m.from(), pr);
       }
     } else {
       if (pr.MaybeUpdate(m.index())) {
-        if (maybeCommit()) {
+        if (deferCommit_) {
+          commitDeferred_ = true;
+        } else if (maybeCommit()) {
           bcastAppend();
         }
 
@@ -695,6 +1124,13 @@ class Raft {
         } else if (pr.State() == Progress::StateProbe) {
           pr.BecomeReplicate();
         }
+
+        // Transfer leadership is in progress.
+        if (m.from() == leadTransferee_ && pr.MatchIndex() == log_->LastIndex()) {
+          FMT_SLOG(INFO,
+                   "%x sent MsgTimeoutNow to %x after received MsgAppResp", id_, m.from());
+          sendTimeoutNow(m.from());
+        }
       }
     }
   }
@@ -724,7 +1160,14 @@ class Raft {
       log_->CommitTo(std::min(m.commit(), newLastIndex));
       send(msg.Index(newLastIndex).v);
     } else {
-      send(msg.Index(m.index()).Reject().RejectHint(log_->LastIndex()).v);
+      // Return a hint to the leader about the maximum index and term that the
+      // two logs could be divergent at. All the entries above the hinted index
+      // are of terms larger than m.logTerm(), so they can't match the
+      // leader's entry at m.index(), nor any entry before it.
+      uint64_t hintIndex = std::min(m.index(), log_->LastIndex());
+      hintIndex = log_->FindConflictByTerm(hintIndex, m.logterm());
+      uint64_t hintTerm = log_->ZeroTermOnErrCompacted(hintIndex);
+      send(msg.Index(m.index()).Reject().RejectHint(hintIndex).LogTerm(hintTerm).v);
     }
   }
 
@@ -738,6 +1181,12 @@ class Raft {
       FMT_SLOG(FATAL, "%x: proposing multiple entries is not allowed", id_);
     }
 
+    if (leadTransferee_ != 0) {
+      FMT_SLOG(INFO, "%x [term %d] transfer leadership to %x is in progress; dropping proposal",
+               id_, currentTerm_, leadTransferee_);
+      return;
+    }
+
     pb::Entry& e = *m.mutable_entries(0);
     if (e.type() == pb::EntryConfChange) {
       if (!pendingConf_) {
@@ -769,20 +1218,57 @@ class Raft {
   // advanceCommitIndex advances commitIndex to the largest index of log having
   // replicated on majority, except When leader's currentTerm is not equal to
   // term of the index (which means it's a new leader).
+  // During a joint consensus the index must be replicated on majorities of both
+  // configurations.
   void advanceCommitIndex() {
     DLOG_ASSERT(role_ == StateRole::kLeader);
     std::vector<uint64_t> matches;
-    for (auto& e : prs_) {
-      matches.push_back(e.second.MatchIndex());
+    auto majorityMatch = [&matches]() {
+      std::sort(matches.begin(), matches.end(), std::greater<uint64_t>());
+      return matches[matches.size() / 2];
+    };
+
+    uint64_t to;
+    if (!IsJoint()) {
+      for (auto& e : prs_) {
+        matches.push_back(e.second.MatchIndex());
+      }
+      to = majorityMatch();
+    } else {
+      auto matchOf = [this](uint64_t id) {
+        auto it = prs_.find(id);
+        return it != prs_.end() ? it->second.MatchIndex() : 0;
+      };
+      for (uint64_t id : incoming_) {
+        matches.push_back(matchOf(id));
+      }
+      to = majorityMatch();
+      matches.clear();
+      for (uint64_t id : outgoing_) {
+        matches.push_back(matchOf(id));
+      }
+      to = std::min(to, majorityMatch());
     }
-    std::sort(matches.begin(), matches.end(), std::greater<uint64_t>());
 
-    uint64_t to = matches[quorum() - 1];
     if (log_->ZeroTermOnErrCompacted(to) == currentTerm_) {
       log_->CommitTo(to);
     }
   }
 
+  // maybeLeaveJoint proposes to leave the joint configuration once the leader
+  // has applied it, so that the transition to the new configuration is automatic.
+  void maybeLeaveJoint() {
+    if (role_ != kLeader || !IsJoint() || pendingConf_ || numOfPendingConf() > 0) {
+      return;
+    }
+
+    pendingConf_ = true;
+    auto cc = PBConfChange().Type(pb::ConfChangeLeaveJoint).v;
+    auto e = PBEntry().Type(pb::EntryConfChange).Data(cc.SerializeAsString()).v;
+    appendRawEntries(PBMessage().Entries({e}).v);
+    bcastAppend();
+  }
+
   // maybeCommit attempts to advance the commit index. Returns true if
   // the commit index changed (in which case the caller should call
   // r.bcastAppend).
@@ -793,7 +1279,8 @@ class Raft {
   }
 
   void campaign(CampaignType type) {
-    DLOG_ASSERT(type == kCampaignElection || type == kCampaignPreElection);
+    DLOG_ASSERT(type == kCampaignElection || type == kCampaignPreElection ||
+                type == kCampaignTransfer);
 
     pb::MessageType voteType;
     uint64_t term = currentTerm_ + 1;
@@ -810,6 +1297,9 @@ class Raft {
 
     auto m =
         PBMessage().Term(term).Type(voteType).Index(log_->LastIndex()).LogTerm(log_->LastTerm());
+    if (type == kCampaignTransfer) {
+      m.Context(new std::string(kCampaignTransferCtx));
+    }
     for (const auto& e : prs_) {
       uint64_t peer_id = e.first;
       if (peer_id == id_)
@@ -821,15 +1311,145 @@ class Raft {
     }
   }
 
+  // REQUIRED: current role is leader.
+  void handleMsgTransferLeader(const pb::Message& m) {
+    uint64_t leadTransferee = m.from();
+    if (HasLearner(leadTransferee)) {
+      FMT_SLOG(INFO, "%x [term %d] ignored transferring leadership to learner %x", id_,
+               currentTerm_, leadTransferee);
+      return;
+    }
+    if (!HasPeer(leadTransferee)) {
+      FMT_SLOG(INFO, "%x [term %d] ignored transferring leadership to unknown node %x", id_,
+               currentTerm_, leadTransferee);
+      return;
+    }
+
+    uint64_t lastLeadTransferee = leadTransferee_;
+    if (lastLeadTransferee != 0) {
+      if (lastLeadTransferee == leadTransferee) {
+        FMT_SLOG(INFO,
+                 "%x [term %d] transfer leadership to %x is in progress, ignores request to same "
+                 "node %x",
+                 id_, currentTerm_, leadTransferee, leadTransferee);
+        return;
+      }
+      abortLeaderTransfer();
+      FMT_SLOG(INFO, "%x [term %d] abort previous transferring leadership to %x", id_,
+               currentTerm_, lastLeadTransferee);
+    }
+    if (leadTransferee == id_) {
+      FMT_SLOG(INFO,
+               "%x is already leader. Ignored transferring leadership to self", id_);
+      return;
+    }
+
+    // Transfer leadership to third party.
+    FMT_SLOG(INFO, "%x [term %d] starts to transfer leadership to %x", id_, currentTerm_,
+             leadTransferee);
+    // Transfer leadership should be finished in one electionTimeout, so reset
+    // electionElapsed.
+    electionElapsed_ = 0;
+    leadTransferee_ = leadTransferee;
+    if (prs_[leadTransferee].MatchIndex() == log_->LastIndex()) {
+      sendTimeoutNow(leadTransferee);
+      FMT_SLOG(INFO,
+               "%x sends MsgTimeoutNow to %x immediately as %x already has up-to-date log", id_,
+               leadTransferee, leadTransferee);
+    } else {
+      sendAppend(leadTransferee);
+    }
+  }
+
+  // forwardTransferLeader redirects a MsgTransferLeader to the current leader.
+  // The from of a MsgTransferLeader is the transferee rather than the sender,
+  // so it's kept as is.
+  void forwardTransferLeader(pb::Message& m) {
+    m.set_to(currentLeader_);
+    send(m);
+  }
+
+  void sendTimeoutNow(uint64_t to) {
+    send(PBMessage().To(to).Type(pb::MsgTimeoutNow).v);
+  }
+
+  void abortLeaderTransfer() {
+    leadTransferee_ = 0;
+  }
+
+  // checkQuorumActive returns true if the quorum is active from
+  // the view of the local raft state machine. Otherwise, it returns
+  // false.
+  // checkQuorumActive also resets all RecentActive to false, including the
+  // learners', which are not counted in the quorum.
+  bool checkQuorumActive() {
+    // self is always active
+    bool active =
+        hasQuorum([this](uint64_t id) { return id == id_ || prs_.at(id).RecentActive(); });
+    for (auto& e : prs_) {
+      if (e.first != id_) {
+        e.second.RecentActive(false);
+      }
+    }
+    for (auto& e : learnerPrs_) {
+      e.second.RecentActive(false);
+    }
+    return active;
+  }
+
   int quorum() const {
     return static_cast<int>(prs_.size() / 2 + 1);
   }
 
+  // hasQuorum returns true if the voters that `pred` returns true for form a
+  // majority, or, during a joint consensus, majorities of both the incoming and
+  // the outgoing voters.
+  template <typename Pred>
+  bool hasQuorum(Pred pred) const {
+    if (!IsJoint()) {
+      size_t n = 0;
+      for (const auto& e : prs_) {
+        n += pred(e.first) ? 1 : 0;
+      }
+      return n >= prs_.size() / 2 + 1;
+    }
+    return majorityOf(incoming_, pred) && majorityOf(outgoing_, pred);
+  }
+
+  template <typename Pred>
+  static bool majorityOf(const std::set<uint64_t>& ids, Pred& pred) {
+    size_t n = 0;
+    for (uint64_t id : ids) {
+      n += pred(id) ? 1 : 0;
+    }
+    return n >= ids.size() / 2 + 1;
+  }
+
   void resetRandomizedElectionTimeout() {
-    static auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-    static std::default_random_engine engine(seed);
-    static std::uniform_int_distribution<int> rand(c_->electionTick, 2 * c_->electionTick - 1);
-    randomizedElectionTimeout_ = rand(engine);
+    randomizedElectionTimeout_ =
+        c_->electionTick + static_cast<int>(nextRandom() % c_->electionTick);
+  }
+
+  static uint64_t initRandomState(const Config& c) {
+    uint64_t seed = c.randomSeed;
+    if (seed == 0) {
+      seed = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+    // splitmix64, so that the adjacent seeds and ids diverge at once.
+    uint64_t z = seed ^ (c.id * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    // xorshift never leaves the zero state.
+    return z != 0 ? z : 1;
+  }
+
+  // nextRandom is a xorshift64* generator.
+  uint64_t nextRandom() {
+    randomState_ ^= randomState_ >> 12;
+    randomState_ ^= randomState_ << 25;
+    randomState_ ^= randomState_ >> 27;
+    return randomState_ * 0x2545F4914F6CDD1DULL;
   }
 
   // restore recovers the state machine from a snapshot. It restores the log and the
@@ -860,6 +1480,10 @@ class Raft {
 
     auto& tmpPbNodes = snap.metadata().conf_state().nodes();
     std::vector<uint64_t> nodes(tmpPbNodes.begin(), tmpPbNodes.end());
+    auto& tmpPbLearners = snap.metadata().conf_state().learners();
+    std::vector<uint64_t> learners(tmpPbLearners.begin(), tmpPbLearners.end());
+    auto& tmpPbOutgoing = snap.metadata().conf_state().nodes_outgoing();
+    std::set<uint64_t> outgoing(tmpPbOutgoing.begin(), tmpPbOutgoing.end());
 
     // apply snapshot only when there's no existing log entry with the same index and term as
     // Snapshot.LastIndex and Snapshot.LastTerm.
@@ -867,13 +1491,32 @@ class Raft {
     log_->Restore(snap);
 
     prs_.clear();
-    for (uint64_t n : nodes) {
+    learnerPrs_.clear();
+    auto restoreProgress = [this](PeerMap& prs, uint64_t n) {
       uint64_t match = 0, next = log_->LastIndex() + 1;
       if (n == id_) {
         match = next - 1;
       }
-      prs_[n].MatchIndex(match).NextIndex(next);
-      FMT_SLOG(INFO, "%x restored progress of %x [%s]", id_, n, prs_[n].ToString());
+      prs[n].MatchIndex(match).NextIndex(next);
+      FMT_SLOG(INFO, "%x restored progress of %x [%s]", id_, n, prs[n].ToString());
+    };
+    for (uint64_t n : nodes) {
+      restoreProgress(prs_, n);
+    }
+    for (uint64_t n : learners) {
+      restoreProgress(learnerPrs_, n);
+    }
+
+    incoming_.clear();
+    outgoing_.clear();
+    if (!outgoing.empty()) {
+      incoming_ = std::set<uint64_t>(nodes.begin(), nodes.end());
+      outgoing_ = outgoing;
+      for (uint64_t n : outgoing_) {
+        if (prs_.find(n) == prs_.end()) {
+          restoreProgress(prs_, n);
+        }
+      }
     }
 
     return true;
@@ -894,7 +1537,7 @@ class Raft {
   }
 
   void handleMsgSnapStatus(pb::Message& m) {
-    Progress& pr = prs_[m.from()];
+    Progress& pr = *getProgress(m.from());
     if (pr.State() != Progress::StateSnapshot) {
       return;
     }
@@ -917,7 +1560,7 @@ class Raft {
   }
 
   void handleMsgUnreachable(pb::Message& m) {
-    Progress& pr = prs_[m.from()];
+    Progress& pr = *getProgress(m.from());
 
     // During optimistic replication, if the remote becomes unreachable,
     // there is huge probability that a MsgApp is lost.
@@ -928,25 +1571,135 @@ class Raft {
                m.from(), pr.ToString());
   }
 
-  void handleMsgReadIndex(pb::Message& m) {
-    if (quorum() > 1) {
+  // The read only requests are not handled one by one, they are queued in
+  // pendingReads_ and sent out together in flushReadIndex, so that a single
+  // round of heartbeat confirms all the requests received in one Ready cycle.
+  void handleMsgReadIndex(const pb::Message& m) {
+    uint64_t id = DecodeReadContext(m.context());
+    if (id == 0) {
+      FMT_SLOG(ERROR, "%x invalid context of MsgReadIndex from %x", id_, m.from());
+      return;
+    }
+
+    ReadRequest req;
+    req.from = (m.from() == 0) ? id_ : m.from();
+    req.id = id;
+    pendingReads_.push_back(req);
+  }
+
+  // flushReadIndex sends out the read only requests batched since last call.
+  // The leader issues one round of heartbeat for them, while a follower forwards
+  // them to the leader as one MsgReadIndex.
+  // It's called once per Ready cycle.
+  void flushReadIndex() {
+    if (pendingReads_.empty()) {
+      return;
+    }
+
+    if (role_ == kLeader) {
+      if (quorum() == 1) {
+        // read directly from current node if quorum == 1
+        for (auto& req : pendingReads_) {
+          respondReadIndex(req, log_->CommitIndex());
+        }
+        pendingReads_.clear();
+        return;
+      }
+
       if (log_->ZeroTermOnErrCompacted(log_->CommitIndex()) != Term()) {
         // Reject read only request when this leader has not committed any log entry at its term.
         // (raft thesis 6.4)
+        pendingReads_.clear();
         return;
       }
 
-      readOnly_.AddRequest(log_->CommitIndex(), m);
-      bcastHeartbeat(&m.entries(0).data());
+      uint64_t seq = readOnly_.AddRequest(log_->CommitIndex(), &pendingReads_);
+      std::string ctx = EncodeReadContext(seq);
+      bcastHeartbeat(&ctx);
+      return;
+    }
+
+    if (role_ != kFollower || currentLeader_ == 0) {
+      FMT_SLOG(INFO, "%x no leader at term %d; dropping %d index reading msgs", id_, currentTerm_,
+               pendingReads_.size());
+      pendingReads_.clear();
+      return;
+    } else if (c_->disableProposalForwarding) {
+      FMT_SLOG(INFO, "%x not forwarding to leader %x at term %d; dropping %d index reading msgs",
+               id_, currentLeader_, currentTerm_, pendingReads_.size());
+      pendingReads_.clear();
+      return;
+    }
+
+    uint64_t batchId = nextReadRequestId();
+    auto& batch = forwardedReads_[batchId];
+    batch.deadline = ticks_ + c_->electionTick;
+    for (auto& req : pendingReads_) {
+      batch.ids.push_back(req.id);
+    }
+    pendingReads_.clear();
+    send(PBMessage()
+             .To(currentLeader_)
+             .Type(pb::MsgReadIndex)
+             .Context(new std::string(EncodeReadContext(batchId)))
+             .v);
+  }
+
+  // REQUIRED: current role is follower.
+  void handleMsgReadIndexResp(const pb::Message& m) {
+    auto it = forwardedReads_.find(DecodeReadContext(m.context()));
+    if (it == forwardedReads_.end()) {
+      FMT_SLOG(INFO, "%x ignored MsgReadIndexResp from %x for unknown read requests", id_,
+               m.from());
+      return;
+    }
+
+    for (uint64_t id : it->second.ids) {
+      readStates_.push_back(ReadState{m.index(), id});
+    }
+    forwardedReads_.erase(it);
+  }
+
+  // The leader drops a forwarded batch without response when it has not
+  // committed an entry at its term, and the MsgReadIndex or the response may be
+  // lost, so the batches not answered within an election timeout are dropped.
+  void expireForwardedReads() {
+    // batch ids and deadlines increase together.
+    auto it = forwardedReads_.begin();
+    for (; it != forwardedReads_.end() && it->second.deadline <= ticks_; ++it) {
+      FMT_SLOG(INFO, "%x read index batch %d expired; dropping %d index reading msgs", id_,
+               it->first, it->second.ids.size());
+    }
+    forwardedReads_.erase(forwardedReads_.begin(), it);
+  }
+
+  // respondReadIndex hands the read index to the local application if the request
+  // was made locally, or sends it back to the follower who forwarded the request.
+  void respondReadIndex(const ReadRequest& req, uint64_t readIndex) {
+    if (req.from == id_) {
+      readStates_.push_back(ReadState{readIndex, req.id});
     } else {
-      // read directly from current node if quorum == 1
-      ReadState readState;
-      readState.index = log_->CommitIndex();
-      readState.requestCtx = std::move(*m.mutable_entries(0)->release_data());
-      readStates_.emplace_back(readState);
+      send(PBMessage()
+               .To(req.from)
+               .Type(pb::MsgReadIndexResp)
+               .Index(readIndex)
+               .Context(new std::string(EncodeReadContext(req.id)))
+               .v);
     }
   }
 
+  uint64_t nextReadRequestId() {
+    return ++lastReadRequestId_;
+  }
+
+  // read only requests that are not handled by the current leader won't
+  // get a response, drop them when the leadership changes.
+  void resetReadOnly() {
+    readOnly_.Reset();
+    pendingReads_.clear();
+    forwardedReads_.clear();
+  }
+
  private:
   friend class RaftTest;
   friend class RaftPaperTest;
@@ -979,6 +1732,10 @@ class Raft {
 
   bool pendingConf_;
 
+  // leadTransferee is id of the leader transfer target when its value is not zero.
+  // Follow the procedure defined in raft thesis 3.10.
+  uint64_t leadTransferee_;
+
   std::unordered_map<uint64_t, bool> voteGranted_;
 
   std::unique_ptr<const Config> c_;
@@ -990,12 +1747,52 @@ class Raft {
   using MailBox = std::vector<pb::Message>;
   MailBox mails_;
 
+  // the images of the MsgSnaps in mails_.
+  MsgSnapshots msgSnapshots_;
+
   // peer id -> Progress
-  using PeerMap = std::unordered_map<uint64_t, Progress>;
+  using PeerMap = ProgressTracker;
   PeerMap prs_;
 
+  // learner id -> Progress. Learners are replicated to, but they don't vote
+  // and are not counted in the quorum.
+  PeerMap learnerPrs_;
+
+  // voters of the new and the old configurations during a joint consensus,
+  // both are empty otherwise. prs_ holds the union of them.
+  std::set<uint64_t> incoming_;
+  std::set<uint64_t> outgoing_;
+
   ReadOnly readOnly_;
   std::vector<ReadState> readStates_;
+
+  // read only requests received in current Ready cycle.
+  std::vector<ReadRequest> pendingReads_;
+
+  // the local read only requests forwarded to the leader in one batch, they
+  // are dropped at tick `deadline` if not answered.
+  struct ForwardedReads {
+    uint64_t deadline;
+    std::vector<uint64_t> ids;
+  };
+
+  // batch id -> the forwarded read only requests.
+  std::map<uint64_t, ForwardedReads> forwardedReads_;
+
+  // ids of read only requests and batches, increases monotonically.
+  uint64_t lastReadRequestId_;
+
+  // number of ticks as a follower or candidate, it never goes backward.
+  uint64_t ticks_;
+
+  // state of the generator of randomizedElectionTimeout, owned by this raft
+  // so that rafts on different threads don't share it.
+  uint64_t randomState_;
+
+  // commitDeferred_ is set when a MsgAppResp updated a match index while
+  // deferCommit_ is on, and is cleared by FlushCommit.
+  bool deferCommit_;
+  bool commitDeferred_;
 };
 
 using RaftUPtr = std::unique_ptr<Raft>;
@@ -43,6 +43,13 @@ class RaftLog {
 
     uint64_t lastIndex = s.GetValue();
     unstable_.offset = lastIndex + 1;
+
+    s = storage_->Term(lastIndex);
+    FATAL_NOT_OK(s, "Storage::Term");
+
+    firstIndex_ = firstIndex;
+    lastIndex_ = lastIndex;
+    lastTerm_ = s.GetValue();
   }
 
   // Raft determines which of two logs is more up-to-date
@@ -77,6 +84,9 @@ class RaftLog {
     }
 
     auto errorCode = s.GetStatus().Code();
+    if (errorCode == Error::LogCompacted) {
+      syncFirstIndex();
+    }
     if (errorCode == Error::OutOfBound || errorCode == Error::LogCompacted) {
       return s.GetStatus();
     }
@@ -86,32 +96,22 @@ class RaftLog {
     return 0;
   }
 
+  // The bounds of the log are cached, since they are read on every vote,
+  // campaign and MsgApp. All the appends go through RaftLog, so the last
+  // index and term are always up-to-date; while the application may compact
+  // the storage behind our back, so the cached first index may be stale
+  // (lower than the actual one), until the storage reports LogCompacted.
+
   uint64_t LastIndex() const {
-    if (!unstable_.entries.empty()) {
-      return unstable_.entries.rbegin()->index();
-    } else if (unstable_.snapshot) {
-      return unstable_.snapshot->metadata().index();
-    } else {
-      auto s = storage_->LastIndex();
-      FATAL_NOT_OK(s, "Storage::LastIndex");
-      return s.GetValue();
-    }
+    return lastIndex_;
   }
 
   uint64_t FirstIndex() const {
-    if (unstable_.snapshot) {
-      // unstable snapshot always precedes all the entries in RaftLog.
-      return unstable_.snapshot->metadata().index() + 1;
-    }
-    auto sw = storage_->FirstIndex();
-    FATAL_NOT_OK(sw, "Storage::FirstIndex");
-    return sw.GetValue();
+    return firstIndex_;
   }
 
   uint64_t LastTerm() const {
-    auto s = Term(LastIndex());
-    FATAL_NOT_OK(s, "RaftLog::Term");
-    return s.GetValue();
+    return lastTerm_;
   }
 
   bool HasEntry(uint64_t index, uint64_t term) {
@@ -148,6 +148,9 @@ class RaftLog {
               commitIndex_);
 #endif
     }
+    auto last = std::prev(end);
+    lastIndex_ = last->index();
+    lastTerm_ = last->term();
     unstable_.TruncateAndAppend(begin, end);
   }
 
@@ -181,19 +184,86 @@ class RaftLog {
   // a different term.
   // The first entry MUST have an index equal to the argument 'from'.
   // The index of the given entries MUST be continuously increasing.
+  //
+  // By the Log Matching Property, the given entries that match the existing
+  // ones form a prefix, so the first conflict is binary searched over the
+  // overlapping range with O(log n) Term lookups.
   EntriesIterator FindConflict(EntriesIterator begin, EntriesIterator end) {
-    for (auto it = begin; it != end; it++) {
-      if (!HasEntry(it->index(), it->term())) {
-        if (it->index() <= LastIndex()) {
-          FMT_SLOG(INFO, "found conflict at index %d [existing term: %d, conflicting term: %d]",
-                   it->index(), ZeroTermOnErrCompacted(it->index()), it->term());
-        }
-        return it;
+    if (begin == end) {
+      return end;
+    }
+
+    uint64_t lo = begin->index();
+    uint64_t hi = std::min(LastIndex() + 1, lo + std::distance(begin, end));
+    size_t overlap = lo < hi ? static_cast<size_t>(hi - lo) : 0;
+
+    // the first `n` entries match the existing ones.
+    size_t n = 0, m = overlap;
+    uint64_t conflictTerm = 0;
+    while (n < m) {
+      size_t mid = n + (m - n) / 2;
+      auto s = Term(lo + mid);
+      if (!s.IsOK()) {
+        // some of the entries are compacted, fall back to checking one by one.
+        return findConflictSlow(begin, end);
+      }
+      if ((begin + mid)->term() == s.GetValue()) {
+        n = mid + 1;
+      } else {
+        m = mid;
+        conflictTerm = s.GetValue();
       }
     }
 
+    auto it = begin + n;
+    if (n < overlap) {
+      FMT_SLOG(INFO, "found conflict at index %d [existing term: %d, conflicting term: %d]",
+               it->index(), conflictTerm, it->term());
+    }
     // returns `end` if no conflict found
-    return end;
+    return it;
+  }
+
+  // FindConflictByTerm returns the largest index <= `index` whose term is <=
+  // `term`, or the first unavailable (compacted) index below it. It's used to
+  // skip over all the entries of the terms that can't match in one probe
+  // after a MsgApp rejection: an entry at the returned index or below may
+  // match the other log, while none above it can.
+  // `index` must not be larger than the last index.
+  // Terms are non-decreasing in index, so the index is binary searched.
+  uint64_t FindConflictByTerm(uint64_t index, uint64_t term) const {
+    if (index > LastIndex()) {
+      FMT_SLOG(WARNING, "index(%d) is out of range [0, lastIndex(%d)] in FindConflictByTerm", index,
+               LastIndex());
+      return index;
+    }
+
+    // the term of a compacted entry is unknown, it's treated as a match so the
+    // search stops there.
+    auto matches = [&](uint64_t i) {
+      auto s = Term(i);
+      return !s.IsOK() || s.GetValue() <= term;
+    };
+
+    uint64_t dummyIndex = FirstIndex() - 1;
+    if (index < dummyIndex || matches(index)) {
+      return index;
+    }
+    if (!matches(dummyIndex)) {
+      return dummyIndex == 0 ? 0 : dummyIndex - 1;
+    }
+
+    // invariant: matches(lo) && !matches(hi)
+    uint64_t lo = dummyIndex, hi = index;
+    while (hi - lo > 1) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (matches(mid)) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
   }
 
   // MaybeAppend returns false and set newLastIndex=0 if the entries cannot be appended. Otherwise,
@@ -260,38 +330,80 @@ class RaftLog {
   // Returns a slice of log entries from lo through hi-1, inclusive.
   // FirstIndex <= lo < hi <= LastIndex + 1
   StatusWith<EntryVec> Entries(uint64_t lo, uint64_t hi, uint64_t maxSize) {
-    RETURN_NOT_OK_APPEND(MustCheckOutOfBounds(lo, hi), "[RaftLog::Entries]");
-    if (lo == hi) {
-      return EntryVec();
+    EntryVec ret;
+    RETURN_NOT_OK_APPEND(
+        ForEachEntry(lo, hi, maxSize, [&](const pb::Entry& e) { ret.push_back(e); }),
+        "[RaftLog::Entries]");
+    return ret;
+  }
+
+  // ForEachEntry calls `fn` on the entries from lo to the last index that
+  // Entries would return, without copying them.
+  Status ForEachEntry(uint64_t lo, uint64_t maxSize, const Storage::EntryVisitor& fn) {
+    if (lo > LastIndex()) {
+      return Status::OK();
+    }
+    return ForEachEntry(lo, LastIndex() + 1, maxSize, fn);
+  }
+
+  // ForEachEntry calls `fn` on the entries in [lo, hi) that Entries would
+  // return, without copying them. The entries are only valid during the call.
+  // FirstIndex <= lo < hi <= LastIndex + 1
+  Status ForEachEntry(uint64_t lo, uint64_t hi, uint64_t maxSize,
+                      const Storage::EntryVisitor& fn) {
+    auto st = MustCheckOutOfBounds(lo, hi);
+    if (!st.IsOK() || lo == hi) {
+      return st;
     }
 
     uint64_t uOffset = unstable_.offset;
-    EntryVec ret;
 
     // retrieve from memory storage
     if (lo < uOffset) {
-      auto s = storage_->Entries(lo, std::min(hi, uOffset), &maxSize);
-
-      if (s.GetStatus().Code() == Error::LogCompacted) {
+      uint64_t visited = 0;
+      auto s = storage_->ForEachEntry(lo, std::min(hi, uOffset), &maxSize,
+                                      [&](const pb::Entry& e) {
+                                        visited++;
+                                        fn(e);
+                                      });
+
+      if (s.Code() == Error::LogCompacted) {
+        syncFirstIndex();
         return s;
       } else {
-        FATAL_NOT_OK(s, "[RaftLog::Entries]");
+        FATAL_NOT_OK(s, "[RaftLog::ForEachEntry]");
       }
-      ret = std::move(s.GetValue());
 
-      // check if ret has reached the size limitation
-      if (ret.size() < std::min(hi, uOffset) - lo) {
-        return ret;
+      // check if it has reached the size limitation
+      if (visited < std::min(hi, uOffset) - lo) {
+        return Status::OK();
       }
     }
 
     // retrieve from unstable
     if (hi > uOffset) {
       lo = std::max(lo, uOffset);
-      unstable_.CopyTo(ret, lo, hi, maxSize);
+      unstable_.ForEach(lo, hi, maxSize, fn);
     }
 
-    return ret;
+    return Status::OK();
+  }
+
+  // PendingConfChanges returns the number of the EntryConfChange entries that
+  // are not committed yet. The indexes of them are kept by unstable and
+  // storage, so the entries are not scanned.
+  size_t PendingConfChanges() const {
+    uint64_t lo = commitIndex_ + 1;
+    size_t n = unstable_.ConfChanges(lo);
+
+    uint64_t stableHi = unstable_.entries.empty() ? lastIndex_ + 1 : unstable_.offset;
+    if (!unstable_.snapshot && lo < stableHi) {
+      std::vector<uint64_t> indexes;
+      auto s = storage_->ConfChangeIndexes(lo, stableHi, &indexes);
+      FATAL_NOT_OK(s, "Storage::ConfChangeIndexes");
+      n += indexes.size();
+    }
+    return n;
   }
 
   uint64_t LastApplied() const {
@@ -326,13 +438,15 @@ class RaftLog {
     FMT_SLOG(INFO, "log [%s] starts to restore snapshot [index: %d, term: %d]", ToString(),
              snap.metadata().index(), snap.metadata().term());
     commitIndex_ = snap.metadata().index();
+    firstIndex_ = snap.metadata().index() + 1;
+    lastIndex_ = snap.metadata().index();
+    lastTerm_ = snap.metadata().term();
     unstable_.Restore(snap);
   }
 
-  // TODO: use shared_ptr to reduce copying
-  StatusWith<pb::Snapshot> Snapshot() const {
+  StatusWith<SnapshotSptr> Snapshot() const {
     if (unstable_.snapshot) {
-      return *unstable_.snapshot;
+      return unstable_.snapshot;
     }
     return storage_->Snapshot();
   }
@@ -347,6 +461,10 @@ class RaftLog {
 
   EntryVec AllEntries() {
     auto s = Entries(FirstIndex(), std::numeric_limits<uint64_t>::max());
+    if (s.GetStatus().Code() == Error::LogCompacted) {
+      // the first index is synced with storage on LogCompacted.
+      s = Entries(FirstIndex(), std::numeric_limits<uint64_t>::max());
+    }
     FATAL_NOT_OK(s, "RaftLog::Entries");
     return s.GetValue();
   }
@@ -356,6 +474,32 @@ class RaftLog {
   }
 
  private:
+  // syncFirstIndex reloads the first index after the storage was compacted.
+  void syncFirstIndex() const {
+    if (unstable_.snapshot) {
+      // unstable snapshot always precedes all the entries in RaftLog.
+      return;
+    }
+    auto s = storage_->FirstIndex();
+    FATAL_NOT_OK(s, "Storage::FirstIndex");
+    firstIndex_ = s.GetValue();
+  }
+
+  // findConflictSlow checks the entries one by one, it's used when some of
+  // them may have been compacted.
+  EntriesIterator findConflictSlow(EntriesIterator begin, EntriesIterator end) {
+    for (auto it = begin; it != end; it++) {
+      if (!HasEntry(it->index(), it->term())) {
+        if (it->index() <= LastIndex()) {
+          FMT_SLOG(INFO, "found conflict at index %d [existing term: %d, conflicting term: %d]",
+                   it->index(), ZeroTermOnErrCompacted(it->index()), it->term());
+        }
+        return it;
+      }
+    }
+    return end;
+  }
+
   friend class RaftLogTest;
 
   // storage contains all stable entries since the last snapshot.
@@ -373,6 +517,11 @@ class RaftLog {
   uint64_t commitIndex_;
   // Index of highest log entry applied to state machine (initialized to 0, increases monotonically)
   uint64_t lastApplied_;
+
+  // the cached bounds of the log, see FirstIndex, LastIndex and LastTerm.
+  mutable uint64_t firstIndex_;
+  uint64_t lastIndex_;
+  uint64_t lastTerm_;
 };
 
 }  // namespace yaraft
@@ -69,6 +69,176 @@ TEST_F(RaftLogTest, FindConflict) {
   }
 }
 
+TEST_F(RaftLogTest, FindConflictByTerm) {
+  struct TestData {
+    EntryVec ents;  // ents[0] is the dummy entry
+    uint64_t index;
+    uint64_t term;
+    uint64_t want;
+  } tests[] = {
+      // log starts from index 1
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       5,
+       6,
+       5},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       5,
+       5,
+       5},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       5,
+       4,
+       2},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       5,
+       2,
+       2},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       5,
+       1,
+       0},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       1,
+       2,
+       1},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       1,
+       1,
+       0},
+      {{pbEntry(0, 0), pbEntry(1, 2), pbEntry(2, 2), pbEntry(3, 5), pbEntry(4, 5), pbEntry(5, 5)},
+       0,
+       0,
+       0},
+      // log with compacted entries
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 30, 3, 30},
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 14, 9, 14},
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 14, 4, 14},
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 14, 3, 12},
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 14, 2, 9},
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 11, 2, 9},
+      {{pbEntry(10, 3), pbEntry(11, 3), pbEntry(12, 3), pbEntry(13, 4), pbEntry(14, 4)}, 10, 2, 9},
+  };
+
+  for (auto tt : tests) {
+    auto storage = new MemoryStorage;
+    if (tt.ents[0].index() > 0) {
+      auto snap = PBSnapshot().MetaIndex(tt.ents[0].index()).MetaTerm(tt.ents[0].term()).v;
+      storage->ApplySnapshot(snap);
+    }
+    RaftLog raftLog(storage);
+    raftLog.Append(EntryVec(tt.ents.begin() + 1, tt.ents.end()));
+
+    ASSERT_EQ(raftLog.FindConflictByTerm(tt.index, tt.term), tt.want);
+  }
+}
+
+// This test ensures FindConflict works on a log spanning storage and unstable.
+TEST_F(RaftLogTest, FindConflictAcrossUnstable) {
+  auto storage = new MemoryStorage;
+  storage->Append({pbEntry(1, 1), pbEntry(2, 1), pbEntry(3, 2)});
+  RaftLog raftLog(storage);
+  raftLog.Append({pbEntry(4, 2), pbEntry(5, 3)});
+
+  auto msg = PBMessage().Entries({pbEntry(2, 1), pbEntry(3, 2), pbEntry(4, 3), pbEntry(5, 3)}).v;
+  auto conflict =
+      raftLog.FindConflict(msg.mutable_entries()->begin(), msg.mutable_entries()->end());
+  ASSERT_EQ(conflict->index(), 4);
+}
+
+// This test ensures the cached bounds follow the appends and restores, and
+// the first index is synced once the compacted storage is accessed.
+TEST_F(RaftLogTest, CachedBounds) {
+  auto storage = new MemoryStorage;
+  for (uint64_t i = 1; i <= 10; i++) {
+    storage->Append(pbEntry(i, 1));
+  }
+  RaftLog log(storage);
+  ASSERT_EQ(log.FirstIndex(), 1);
+  ASSERT_EQ(log.LastIndex(), 10);
+  ASSERT_EQ(log.LastTerm(), 1);
+
+  log.Append({pbEntry(11, 2), pbEntry(12, 2)});
+  ASSERT_EQ(log.LastIndex(), 12);
+  ASSERT_EQ(log.LastTerm(), 2);
+
+  // truncate the unstable entries
+  log.Append(pbEntry(12, 3));
+  ASSERT_EQ(log.LastIndex(), 12);
+  ASSERT_EQ(log.LastTerm(), 3);
+
+  ASSERT_OK(storage->Compact(5));
+  ASSERT_EQ(log.Term(3).GetStatus().Code(), Error::LogCompacted);
+  ASSERT_EQ(log.FirstIndex(), 6);
+  ASSERT_EQ(log.AllEntries().size(), 7);
+
+  auto snap = PBSnapshot().MetaIndex(20).MetaTerm(4).v;
+  log.Restore(snap);
+  ASSERT_EQ(log.FirstIndex(), 21);
+  ASSERT_EQ(log.LastIndex(), 20);
+  ASSERT_EQ(log.LastTerm(), 4);
+}
+
+// This test ensures PendingConfChanges counts the uncommitted EntryConfChange
+// entries across storage and unstable.
+TEST_F(RaftLogTest, PendingConfChanges) {
+  auto conf = [](uint64_t i, uint64_t t) {
+    return PBEntry().Index(i).Term(t).Type(pb::EntryConfChange).v;
+  };
+
+  auto storage = new MemoryStorage;
+  storage->Append({pbEntry(1, 1), conf(2, 1), pbEntry(3, 1)});
+  RaftLog log(storage);
+  ASSERT_EQ(log.PendingConfChanges(), 1);
+
+  log.Append({conf(4, 2), pbEntry(5, 2), conf(6, 2)});
+  ASSERT_EQ(log.PendingConfChanges(), 3);
+
+  // truncate the unstable entries
+  log.Append(pbEntry(6, 3));
+  ASSERT_EQ(log.PendingConfChanges(), 2);
+  log.Append(pbEntry(4, 3));
+  ASSERT_EQ(log.PendingConfChanges(), 1);
+
+  log.CommitTo(2);
+  ASSERT_EQ(log.PendingConfChanges(), 0);
+  log.Append(conf(5, 3));
+  ASSERT_EQ(log.PendingConfChanges(), 1);
+  log.CommitTo(5);
+  ASSERT_EQ(log.PendingConfChanges(), 0);
+}
+
+// This test ensures ForEachEntry visits the entries across storage and
+// unstable, and stops at the size limit.
+TEST_F(RaftLogTest, ForEachEntry) {
+  auto storage = new MemoryStorage;
+  storage->Append({pbEntry(1, 1), pbEntry(2, 1)});
+  RaftLog log(storage);
+  log.Append({pbEntry(3, 2), pbEntry(4, 2)});
+
+  uint64_t size = pbEntry(1, 1).ByteSize();
+  struct TestData {
+    uint64_t lo, maxSize;
+
+    std::vector<uint64_t> windexes;
+  } tests[] = {
+      {1, noLimit, {1, 2, 3, 4}},
+      {2, noLimit, {2, 3, 4}},
+      {3, noLimit, {3, 4}},
+      {5, noLimit, {}},
+      // at least one entry is returned from storage.
+      {1, 0, {1}},
+      {1, size * 3, {1, 2, 3}},
+      {3, size, {3}},
+  };
+
+  for (auto tt : tests) {
+    std::vector<uint64_t> indexes;
+    ASSERT_OK(log.ForEachEntry(tt.lo, tt.maxSize,
+                               [&](const pb::Entry& e) { indexes.push_back(e.index()); }));
+    ASSERT_EQ(indexes, tt.windexes);
+  }
+}
+
 TEST_F(RaftLogTest, IsUpToDate) {}
 
 TEST_F(RaftLogTest, Term) {
@@ -242,7 +412,7 @@ TEST_F(RaftLogTest, MaybeAppend) {
       {
           prevTerm - 2,
           prevIndex - 2,
-          {pbEntry(prevIndex - 1, prevTerm), pbEntry(prevIndex, prevTerm)},
+          {pbEntry(prevIndex - 1, prevTerm + 1), pbEntry(prevIndex, prevTerm + 1)},
           prevIndex,
           true,
           false,
@@ -352,7 +522,7 @@ TEST_F(RaftLogTest, CommitTo) {
     try {
       raftLog.CommitTo(commit);
       raftLog.CommitTo(tt.commit);
-    } catch (RaftError e) {
+    } catch (const RaftError& e) {
       panic = true;
     }
     ASSERT_EQ(panic, tt.wpanic);
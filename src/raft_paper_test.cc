@@ -443,7 +443,7 @@ class RaftPaperTest : public BaseTest {
 
     // clean up noop entry generated when leader elected
     r->mails_.clear();
-    r->log_->GetUnstable().entries.clear();
+    r->log_->GetUnstable().TEST_Entries().clear();
 
     auto ents = {PBEntry().Data("some data").v};
     uint64_t li = r->log_->LastIndex();
@@ -482,7 +482,7 @@ class RaftPaperTest : public BaseTest {
 
     // clean up noop entry generated when leader elected
     r->mails_.clear();
-    r->log_->GetUnstable().entries.clear();
+    r->log_->GetUnstable().TEST_Entries().clear();
 
     uint64_t li = r->log_->LastIndex();
     auto ents = {PBEntry().Data("some data").v};
@@ -13,6 +13,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <thread>
+
+#include "applied_index.h"
 #include "memory_storage.h"
 #include "raft.h"
 #include "test_utils.h"
@@ -40,22 +43,23 @@ class RaftTest : public BaseTest {
       Raft* sm;
       int proposals;
       uint64_t wri;
-      std::string wctx;
+      uint64_t wid;
     } tests[] = {
-        {a, 10, 11, "ctx1"}, {a, 10, 21, "ctx2"},
+        {a, 10, 11, 1}, {b, 10, 21, 2}, {c, 10, 31, 3},
+        {a, 10, 41, 4}, {b, 10, 51, 5}, {c, 10, 61, 6},
     };
 
     for (auto tt : tests) {
       for (int j = 0; j < tt.proposals; j++) {
         nt->Propose(1, "");
       }
-      nt->ReadIndex(tt.sm->id_, tt.wctx);
+      nt->ReadIndex(tt.sm->id_, tt.wid);
 
       auto r = tt.sm;
       ASSERT_EQ(r->readStates_.size(), 1);
 
       ASSERT_EQ(r->readStates_[0].index, tt.wri);
-      ASSERT_EQ(r->readStates_[0].requestCtx, tt.wctx);
+      ASSERT_EQ(r->readStates_[0].requestId, tt.wid);
 
       r->readStates_.clear();
     }
@@ -94,7 +98,7 @@ class RaftTest : public BaseTest {
     ASSERT_EQ(p1->role_, Raft::kLeader);
 
     // Ensure p1 drops read only request.
-    net->ReadIndex(1, "ctx");
+    net->ReadIndex(1, 1);
     ASSERT_EQ(p1->readStates_.size(), 0);
 
     net->Recover();
@@ -109,11 +113,231 @@ class RaftTest : public BaseTest {
     uint64_t lastLogTerm = p1->log_->ZeroTermOnErrCompacted(p1->log_->CommitIndex());
     ASSERT_EQ(lastLogTerm, p1->Term());
 
-    std::string ctx = "ctx";
-    net->ReadIndex(1, ctx);
+    net->ReadIndex(1, 2);
     ASSERT_EQ(p1->readStates_.size(), 1);
     ASSERT_EQ(p1->readStates_[0].index, 4);
-    ASSERT_EQ(p1->readStates_[0].requestCtx, ctx);
+    ASSERT_EQ(p1->readStates_[0].requestId, 2);
+  }
+
+  // TestReadIndexForwardedByFollower ensures that the leader replies a MsgReadIndexResp
+  // to the follower that forwarded the read only request, once the heartbeat round
+  // is acknowledged by a quorum.
+  static void TestReadIndexForwardedByFollower() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    r->becomeCandidate();
+    r->becomeLeader();
+    r->appendRawEntries(PBMessage().Entries({PBEntry().v}).v);
+    r->Step(PBMessage().From(2).To(1).Type(pb::MsgAppResp).Index(1).Term(r->Term()).v);
+    ASSERT_EQ(r->log_->CommitIndex(), 1);
+    r->mails_.clear();
+
+    uint64_t followerReqId = 7;
+    r->Step(PBMessage()
+                .From(2)
+                .To(1)
+                .Term(r->Term())
+                .Type(pb::MsgReadIndex)
+                .Context(new std::string(EncodeReadContext(followerReqId)))
+                .v);
+    r->flushReadIndex();
+    ASSERT_EQ(r->mails_.size(), 2);
+    std::string ctx = r->mails_[0].context();
+    for (auto& m : r->mails_) {
+      ASSERT_EQ(m.type(), pb::MsgHeartbeat);
+      ASSERT_EQ(m.context(), ctx);
+    }
+    r->mails_.clear();
+
+    r->Step(PBMessage()
+                .From(3)
+                .To(1)
+                .Term(r->Term())
+                .Type(pb::MsgHeartbeatResp)
+                .Context(new std::string(ctx))
+                .v);
+    ASSERT_EQ(r->readStates_.size(), 0);
+
+    std::vector<pb::Message> resps;
+    for (auto& m : r->mails_) {
+      if (m.type() == pb::MsgReadIndexResp) {
+        resps.push_back(m);
+      }
+    }
+    ASSERT_EQ(resps.size(), 1);
+
+    pb::Message& resp = resps[0];
+    ASSERT_EQ(resp.to(), 2);
+    ASSERT_EQ(resp.index(), 1);
+    ASSERT_EQ(DecodeReadContext(resp.context()), followerReqId);
+  }
+
+  // TestForwardedReadIndexExpired ensures that a follower drops the read only
+  // requests forwarded to a leader that dropped them, after an election timeout.
+  static void TestForwardedReadIndexExpired() {
+    RaftUPtr leader(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    leader->becomeCandidate();
+    leader->becomeLeader();
+    leader->mails_.clear();
+
+    RaftUPtr follower(newTestRaft(2, {1, 2, 3}, 10, 1, new MemoryStorage));
+    follower->becomeFollower(leader->Term(), 1);
+    follower->Step(PBMessage()
+                       .From(2)
+                       .To(2)
+                       .Type(pb::MsgReadIndex)
+                       .Context(new std::string(EncodeReadContext(7)))
+                       .v);
+    follower->flushReadIndex();
+    ASSERT_EQ(follower->mails_.size(), 1);
+    pb::Message req = follower->mails_[0];
+    ASSERT_EQ(req.type(), pb::MsgReadIndex);
+    follower->mails_.clear();
+
+    // the leader has not committed an entry at its term, it drops the request.
+    req.set_term(leader->Term());
+    leader->Step(req);
+    leader->flushReadIndex();
+    ASSERT_TRUE(leader->mails_.empty());
+    ASSERT_EQ(follower->forwardedReads_.size(), 1);
+
+    // the leader keeps sending heartbeats, so the follower doesn't campaign.
+    auto heartbeat = PBMessage().From(1).To(2).Term(leader->Term()).Type(pb::MsgHeartbeat).v;
+    for (int i = 0; i < 9; i++) {
+      follower->Step(heartbeat);
+      follower->Tick();
+    }
+    ASSERT_EQ(follower->forwardedReads_.size(), 1);
+    follower->Tick();
+    ASSERT_TRUE(follower->forwardedReads_.empty());
+    ASSERT_EQ(follower->role_, Raft::kFollower);
+
+    // a late response is ignored.
+    follower->Step(PBMessage()
+                       .From(1)
+                       .To(2)
+                       .Term(leader->Term())
+                       .Type(pb::MsgReadIndexResp)
+                       .Index(1)
+                       .Context(new std::string(req.context()))
+                       .v);
+    ASSERT_TRUE(follower->readStates_.empty());
+  }
+
+  // TestReadOnlyRingBuffer ensures that ReadOnly keeps the pending batches in order
+  // while its ring buffer grows, and confirms every batch up to the acknowledged one.
+  static void TestReadOnlyRingBuffer() {
+    ReadOnly ro;
+    std::vector<uint64_t> seqs;
+    for (uint64_t i = 1; i <= 100; i++) {
+      std::vector<ReadRequest> reqs{{1, i}, {1, i + 1000}};
+      seqs.push_back(ro.AddRequest(i, &reqs));
+      ASSERT_TRUE(reqs.empty());
+    }
+    ASSERT_EQ(ro.PendingSize(), 100);
+
+    auto ack = [](uint64_t from, uint64_t seq) {
+      return PBMessage()
+          .From(from)
+          .Type(pb::MsgHeartbeatResp)
+          .Context(new std::string(EncodeReadContext(seq)))
+          .v;
+    };
+
+    // acks from the same peer are counted once.
+    ASSERT_EQ(ro.RecvAck(ack(2, seqs[49])), 2);
+    ASSERT_EQ(ro.RecvAck(ack(2, seqs[49])), 2);
+    ASSERT_EQ(ro.RecvAck(ack(3, seqs[49])), 3);
+
+    std::vector<uint64_t> indexes, ids;
+    ro.Advance(ack(3, seqs[49]), [&](uint64_t index, const std::vector<ReadRequest>& reqs) {
+      indexes.push_back(index);
+      for (auto& req : reqs) {
+        ids.push_back(req.id);
+      }
+    });
+    ASSERT_EQ(indexes.size(), 50);
+    ASSERT_EQ(ids.size(), 100);
+    for (uint64_t i = 1; i <= 50; i++) {
+      ASSERT_EQ(indexes[i - 1], i);
+      ASSERT_EQ(ids[2 * (i - 1)], i);
+      ASSERT_EQ(ids[2 * (i - 1) + 1], i + 1000);
+    }
+    ASSERT_EQ(ro.PendingSize(), 50);
+
+    // confirmed batches are no longer acknowledged.
+    ASSERT_EQ(ro.RecvAck(ack(2, seqs[0])), 0);
+    ASSERT_EQ(ro.RecvAck(ack(2, seqs[99])), 2);
+
+    ro.Reset();
+    ASSERT_EQ(ro.PendingSize(), 0);
+    ASSERT_EQ(ro.RecvAck(ack(2, seqs[99])), 0);
+  }
+
+  // TestReadOnlyRemovePeer ensures that the acks from a removed peer are dropped,
+  // and its slot in the ack bitmaps is reused, however many peers have been
+  // removed while read only requests are pending.
+  static void TestReadOnlyRemovePeer() {
+    ReadOnly ro;
+    auto ack = [](uint64_t from, uint64_t seq) {
+      return PBMessage()
+          .From(from)
+          .Type(pb::MsgHeartbeatResp)
+          .Context(new std::string(EncodeReadContext(seq)))
+          .v;
+    };
+
+    std::vector<ReadRequest> reqs{{1, 1}};
+    uint64_t seq = ro.AddRequest(1, &reqs);
+    ASSERT_EQ(ro.RecvAck(ack(2, seq)), 2);
+    ro.RemovePeer(2);
+    ASSERT_FALSE(ro.Acked(ack(2, seq), 2));
+    ASSERT_EQ(ro.RecvAck(ack(3, seq)), 2);
+
+    for (uint64_t id = 4; id < 4 + 10 * kMaxVoters; id++) {
+      ASSERT_EQ(ro.RecvAck(ack(id, seq)), 3);
+      ASSERT_TRUE(ro.Acked(ack(id, seq), id));
+      ro.RemovePeer(id);
+    }
+    ASSERT_EQ(ro.PendingSize(), 1);
+  }
+
+  // TestReadIndexBatch ensures that all the read only requests received within one
+  // Ready cycle are confirmed by a single round of heartbeat.
+  static void TestReadIndexBatch() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    r->becomeCandidate();
+    r->becomeLeader();
+    r->appendRawEntries(PBMessage().Entries({PBEntry().v}).v);
+    r->Step(PBMessage().From(2).To(1).Type(pb::MsgAppResp).Index(1).Term(r->Term()).v);
+    r->mails_.clear();
+
+    for (uint64_t id = 1; id <= 10; id++) {
+      r->Step(PBMessage()
+                  .From(1)
+                  .To(1)
+                  .Type(pb::MsgReadIndex)
+                  .Context(new std::string(EncodeReadContext(id)))
+                  .v);
+    }
+    ASSERT_EQ(r->mails_.size(), 0);
+
+    r->flushReadIndex();
+    ASSERT_EQ(r->mails_.size(), 2);
+    std::string ctx = r->mails_[0].context();
+    r->mails_.clear();
+
+    r->Step(PBMessage()
+                .From(2)
+                .To(1)
+                .Term(r->Term())
+                .Type(pb::MsgHeartbeatResp)
+                .Context(new std::string(ctx))
+                .v);
+    ASSERT_EQ(r->readStates_.size(), 10);
+    for (uint64_t id = 1; id <= 10; id++) {
+      ASSERT_EQ(r->readStates_[id - 1].index, 1);
+      ASSERT_EQ(r->readStates_[id - 1].requestId, id);
+    }
   }
 };
 
@@ -127,4 +351,44 @@ TEST_F(RaftTest, TestReadOnlyOptionSafe) {
 
 TEST_F(RaftTest, TestReadOnlyForNewLeader) {
   RaftTest::TestReadOnlyForNewLeader();
-}
\ No newline at end of file
+}
+
+TEST_F(RaftTest, TestReadIndexForwardedByFollower) {
+  RaftTest::TestReadIndexForwardedByFollower();
+}
+
+TEST_F(RaftTest, TestForwardedReadIndexExpired) {
+  RaftTest::TestForwardedReadIndexExpired();
+}
+
+TEST_F(RaftTest, TestReadIndexBatch) {
+  RaftTest::TestReadIndexBatch();
+}
+
+TEST_F(RaftTest, TestReadOnlyRingBuffer) {
+  RaftTest::TestReadOnlyRingBuffer();
+}
+
+TEST_F(RaftTest, TestReadOnlyRemovePeer) {
+  RaftTest::TestReadOnlyRemovePeer();
+}
+
+TEST_F(RaftTest, AppliedIndex) {
+  AppliedIndex applied(5);
+  ASSERT_TRUE(applied.Reached(5));
+  ASSERT_FALSE(applied.Reached(6));
+  ASSERT_FALSE(applied.WaitFor(6, std::chrono::milliseconds(10)));
+
+  // never moves backwards
+  applied.Advance(3);
+  ASSERT_EQ(applied.Load(), 5);
+
+  std::thread applier([&]() {
+    for (uint64_t i = 6; i <= 100; i++) {
+      applied.Advance(i);
+    }
+  });
+  ASSERT_TRUE(applied.WaitFor(100, std::chrono::seconds(10)));
+  applier.join();
+  ASSERT_EQ(applied.Load(), 100);
+}
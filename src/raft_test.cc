@@ -522,12 +522,15 @@ class RaftTest : public BaseTest {
     ASSERT_EQ(r->log_->CommitIndex(), commit + 1);
   }
 
-  static void TestProvideSnap() {
+  static void TestProvideSnap(bool detachSnapshots) {
     // restore the state machine from a snapshot so it has a compacted log and a snapshot
     auto snap = PBSnapshot().MetaIndex(11).MetaTerm(11).MetaConfState({1, 2}).v;
+    snap.set_data("image");
 
     auto storage = new MemoryStorage;
-    RaftUPtr r(newTestRaft(1, {1}, 10, 1, storage));
+    auto conf = newTestConfig(1, {1}, 10, 1, storage);
+    conf->detachSnapshots = detachSnapshots;
+    RaftUPtr r(new Raft(conf));
     r->restore(snap);
 
     r->becomeCandidate();
@@ -547,6 +550,18 @@ class RaftTest : public BaseTest {
 
     ASSERT_EQ(r->mails_.size(), 1);
     ASSERT_EQ(r->mails_[0].type(), pb::MsgSnap);
+
+    ASSERT_EQ(r->mails_[0].snapshot().metadata().index(), 11);
+    if (!detachSnapshots) {
+      ASSERT_EQ(r->mails_[0].snapshot().data(), "image");
+      ASSERT_TRUE(r->msgSnapshots_.empty());
+      return;
+    }
+
+    // the message carries only the metadata, the image is shared.
+    ASSERT_FALSE(r->mails_[0].snapshot().has_data());
+    ASSERT_EQ(r->msgSnapshots_.size(), 1);
+    ASSERT_EQ(r->msgSnapshots_[11]->data(), "image");
   }
 
   // TestProgressResumeByHeartbeatResp ensures raft.heartbeat reset progress.paused by heartbeat
@@ -655,6 +670,787 @@ class RaftTest : public BaseTest {
     ASSERT_FALSE(r->pendingConf_);
     ASSERT_EQ(r->Peers(), std::set<uint64_t>({1}));
   }
+
+  // TestAddLearner tests that addLearner could update pendingConf and learners,
+  // and that adding the learner as a node promotes it to voter.
+  static void TestAddLearner() {
+    RaftUPtr r(newTestRaft(1, {1}, 10, 1, new MemoryStorage));
+    r->pendingConf_ = true;
+    r->AddLearner(2);
+
+    ASSERT_FALSE(r->pendingConf_);
+    ASSERT_EQ(r->Peers(), std::set<uint64_t>({1}));
+    ASSERT_EQ(r->Learners(), std::set<uint64_t>({2}));
+
+    // a voter can't be demoted to learner.
+    r->AddLearner(1);
+    ASSERT_EQ(r->Learners(), std::set<uint64_t>({2}));
+
+    r->AddNode(2);
+    ASSERT_EQ(r->Peers(), std::set<uint64_t>({1, 2}));
+    ASSERT_TRUE(r->Learners().empty());
+
+    r->AddLearner(3);
+    r->RemoveNode(3);
+    ASSERT_TRUE(r->Learners().empty());
+  }
+
+  // TestLearnerElectionTimeout verifies that the learner doesn't campaign
+  // after the election timeout, nor when it's asked to.
+  static void TestLearnerElectionTimeout() {
+    RaftUPtr n2(newTestLearnerRaft(2, {1}, {2}, 10, 1, new MemoryStorage));
+    ASSERT_TRUE(n2->IsLearner());
+
+    for (int i = 0; i < 2 * 10; i++) {
+      n2->Tick();
+    }
+    ASSERT_EQ(n2->role_, Raft::kFollower);
+
+    n2->Step(PBMessage().From(2).To(2).Type(pb::MsgHup).v);
+    ASSERT_EQ(n2->role_, Raft::kFollower);
+    ASSERT_TRUE(n2->mails_.empty());
+  }
+
+  // TestLearnerCannotVote verifies that a learner ignores vote requests.
+  static void TestLearnerCannotVote() {
+    RaftUPtr n2(newTestLearnerRaft(2, {1}, {2}, 10, 1, new MemoryStorage));
+    n2->Step(PBMessage().From(1).To(2).Term(2).Type(pb::MsgVote).LogTerm(11).Index(11).v);
+    ASSERT_TRUE(n2->mails_.empty());
+    n2->Step(PBMessage().From(1).To(2).Term(3).Type(pb::MsgPreVote).LogTerm(11).Index(11).v);
+    ASSERT_TRUE(n2->mails_.empty());
+  }
+
+  // TestLearnerLogReplication tests that a learner receives entries from the
+  // leader, while the commit index is advanced by voters only.
+  static void TestLearnerLogReplication() {
+    std::unique_ptr<Network> n(
+        new Network({newTestLearnerRaft(1, {1}, {2}, 10, 1, new MemoryStorage),
+                     newTestLearnerRaft(2, {1}, {2}, 10, 1, new MemoryStorage)}));
+    Raft* n1 = n->Peer(1);
+    Raft* n2 = n->Peer(2);
+
+    n->StartElection(1);
+    ASSERT_EQ(n1->role_, Raft::kLeader);
+    ASSERT_EQ(n1->quorum(), 1);
+    ASSERT_EQ(n2->role_, Raft::kFollower);
+
+    // the learner doesn't block the leader from committing.
+    n->Ignore(pb::MsgApp);
+    n->Propose(1);
+    ASSERT_EQ(n1->log_->CommitIndex(), 2);
+    ASSERT_EQ(n2->log_->LastIndex(), 1);
+
+    n->Recover();
+    n->Propose(1);
+    ASSERT_EQ(n1->log_->CommitIndex(), 3);
+    ASSERT_EQ(n2->log_->LastIndex(), 3);
+    ASSERT_EQ(n1->learnerPrs_[2].MatchIndex(), 3);
+  }
+
+  // TestLearnerPromotion verifies that a learner campaigns once it's promoted
+  // to voter.
+  static void TestLearnerPromotion() {
+    std::unique_ptr<Network> n(
+        new Network({newTestLearnerRaft(1, {1}, {2}, 10, 1, new MemoryStorage),
+                     newTestLearnerRaft(2, {1}, {2}, 10, 1, new MemoryStorage)}));
+    Raft* n1 = n->Peer(1);
+    Raft* n2 = n->Peer(2);
+
+    n->StartElection(1);
+    ASSERT_EQ(n1->role_, Raft::kLeader);
+
+    n1->AddNode(2);
+    n2->AddNode(2);
+    ASSERT_FALSE(n2->IsLearner());
+    ASSERT_EQ(n1->quorum(), 2);
+
+    n->StartElection(2);
+    ASSERT_EQ(n1->role_, Raft::kFollower);
+    ASSERT_EQ(n2->role_, Raft::kLeader);
+  }
+
+  // TestLearnerRecentActive verifies that the leader tracks the activity of a
+  // learner like a voter's, but doesn't count it in the quorum.
+  static void TestLearnerRecentActive() {
+    RaftUPtr r(newTestLearnerRaft(1, {1, 2}, {3}, 10, 1, new MemoryStorage));
+    r->becomeCandidate();
+    r->becomeLeader();
+
+    r->Step(PBMessage().From(3).To(1).Term(r->currentTerm_).Type(pb::MsgHeartbeatResp).v);
+    ASSERT_TRUE(r->learnerPrs_[3].RecentActive());
+
+    // the active learner doesn't make up a quorum with the leader.
+    r->Step(PBMessage().From(1).To(1).Type(pb::MsgCheckQuorum).v);
+    ASSERT_EQ(r->role_, Raft::kFollower);
+    ASSERT_FALSE(r->learnerPrs_[3].RecentActive());
+  }
+
+  // TestRestoreWithLearner restores a snapshot which contains learners.
+  static void TestRestoreWithLearner() {
+    auto s = PBSnapshot().MetaIndex(11).MetaTerm(11).MetaConfState({1, 2}).v;
+    s.mutable_metadata()->mutable_conf_state()->add_learners(3);
+
+    RaftUPtr r(newTestLearnerRaft(3, {1, 2}, {3}, 10, 1, new MemoryStorage));
+    ASSERT_TRUE(r->restore(s));
+
+    ASSERT_EQ(r->log_->LastIndex(), 11);
+    ASSERT_EQ(r->Peers(), std::set<uint64_t>({1, 2}));
+    ASSERT_EQ(r->Learners(), std::set<uint64_t>({3}));
+    ASSERT_FALSE(r->promotable());
+  }
+
+  // TestJointConsensusCommit ensures that in a joint configuration an entry is
+  // committed only when it's replicated on majorities of both configurations.
+  static void TestJointConsensusCommit() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 10, 1,
+                           new MemoryStorage({pbEntry(1, 1), pbEntry(2, 1)})));
+    r->loadState(PBHardState().Term(1).v);
+    r->EnterJoint({1, 4, 5});
+    ASSERT_TRUE(r->IsJoint());
+    ASSERT_EQ(r->Peers(), std::set<uint64_t>({1, 2, 3, 4, 5}));
+
+    r->role_ = Raft::kLeader;
+    r->prs_[1].MatchIndex(2);
+    r->prs_[2].MatchIndex(2);
+    r->advanceCommitIndex();
+    ASSERT_EQ(r->log_->CommitIndex(), 0);
+
+    r->prs_[4].MatchIndex(1);
+    r->advanceCommitIndex();
+    ASSERT_EQ(r->log_->CommitIndex(), 1);
+
+    r->prs_[5].MatchIndex(2);
+    r->advanceCommitIndex();
+    ASSERT_EQ(r->log_->CommitIndex(), 2);
+  }
+
+  // TestJointConsensusElection ensures that in a joint configuration a candidate
+  // needs majorities of both configurations to win, and loses when either of
+  // them rejects it.
+  static void TestJointConsensusElection() {
+    for (bool win : {true, false}) {
+      RaftUPtr r(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+      r->EnterJoint({1, 4, 5});
+      r->Step(PBMessage().From(1).To(1).Type(pb::MsgHup).v);
+      ASSERT_EQ(r->role_, Raft::kCandidate);
+      ASSERT_EQ(r->mails_.size(), 4);
+
+      uint64_t term = r->Term();
+      r->Step(PBMessage().From(2).To(1).Term(term).Type(pb::MsgVoteResp).v);
+      r->Step(PBMessage().From(3).To(1).Term(term).Type(pb::MsgVoteResp).v);
+      ASSERT_EQ(r->role_, Raft::kCandidate);
+
+      if (win) {
+        r->Step(PBMessage().From(4).To(1).Term(term).Type(pb::MsgVoteResp).v);
+        ASSERT_EQ(r->role_, Raft::kLeader);
+      } else {
+        r->Step(PBMessage().From(4).To(1).Term(term).Type(pb::MsgVoteResp).Reject().v);
+        r->Step(PBMessage().From(5).To(1).Term(term).Type(pb::MsgVoteResp).Reject().v);
+        ASSERT_EQ(r->role_, Raft::kFollower);
+      }
+    }
+  }
+
+  // TestJointConsensusAutoLeave ensures that the leader proposes to leave the
+  // joint configuration after applying it, and the voters are replaced once
+  // that's applied.
+  static void TestJointConsensusAutoLeave() {
+    std::vector<Raft*> peers;
+    for (uint64_t id = 1; id <= 5; id++) {
+      peers.push_back(newTestRaft(id, {1, 2, 3}, 10, 1, new MemoryStorage));
+    }
+    std::unique_ptr<Network> n(new Network(peers));
+    n->StartElection(1);
+    Raft* lead = n->Peer(1);
+    ASSERT_EQ(lead->role_, Raft::kLeader);
+
+    auto cc = PBConfChange().Type(pb::ConfChangeBeginJoint).Voters({1, 4, 5}).v;
+    n->Send(PBMessage()
+                .From(1)
+                .To(1)
+                .Type(pb::MsgProp)
+                .Entries({PBEntry().Type(pb::EntryConfChange).Data(cc.SerializeAsString()).v})
+                .v);
+    uint64_t beginIndex = lead->log_->LastIndex();
+    ASSERT_EQ(lead->log_->CommitIndex(), beginIndex);
+
+    // the applications apply the joint configuration
+    for (auto r : n->Peers()) {
+      r->EnterJoint({1, 4, 5});
+    }
+    ASSERT_EQ(lead->log_->LastIndex(), beginIndex + 1);
+    ASSERT_TRUE(lead->pendingConf_);
+
+    n->Send(PBMessage().From(1).To(1).Type(pb::MsgBeat).v);
+    ASSERT_EQ(lead->log_->CommitIndex(), beginIndex + 1);
+    ASSERT_EQ(n->Peer(4)->log_->LastIndex(), beginIndex + 1);
+
+    auto s = lead->log_->Entries(beginIndex + 1, UINT64_MAX);
+    ASSERT_OK(s);
+    pb::ConfChange leave;
+    leave.ParseFromString(s.GetValue()[0].data());
+    ASSERT_EQ(leave.type(), pb::ConfChangeLeaveJoint);
+
+    for (auto r : n->Peers()) {
+      r->LeaveJoint();
+    }
+    ASSERT_FALSE(lead->IsJoint());
+    ASSERT_EQ(lead->Peers(), std::set<uint64_t>({1, 4, 5}));
+    ASSERT_EQ(lead->CurrentConfState().nodes_outgoing_size(), 0);
+  }
+
+  // TestJointConsensusRemoveLeader ensures that a leader which is not in the new
+  // configuration steps down after leaving the joint configuration.
+  static void TestJointConsensusRemoveLeader() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    r->becomeCandidate();
+    r->becomeLeader();
+
+    r->EnterJoint({2, 3, 4});
+    pb::ConfState cs = r->CurrentConfState();
+    ASSERT_EQ(std::set<uint64_t>(cs.nodes().begin(), cs.nodes().end()),
+              std::set<uint64_t>({2, 3, 4}));
+    ASSERT_EQ(std::set<uint64_t>(cs.nodes_outgoing().begin(), cs.nodes_outgoing().end()),
+              std::set<uint64_t>({1, 2, 3}));
+
+    r->LeaveJoint();
+    ASSERT_EQ(r->role_, Raft::kFollower);
+    ASSERT_EQ(r->Peers(), std::set<uint64_t>({2, 3, 4}));
+  }
+
+  // TestRemovedNodeNeverCampaigns ensures that a voter removed from the
+  // configuration, by RemoveNode or by leaving a joint configuration, doesn't
+  // campaign once the leader stops sending it heartbeats.
+  static void TestRemovedNodeNeverCampaigns() {
+    RaftUPtr r1(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    r1->RemoveNode(1);
+
+    RaftUPtr r2(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    r2->EnterJoint({2, 3, 4});
+    r2->LeaveJoint();
+
+    for (Raft* r : {r1.get(), r2.get()}) {
+      for (int i = 0; i < 2 * 10 * 3; i++) {
+        r->Tick();
+      }
+      r->Step(PBMessage().From(1).To(1).Type(pb::MsgHup).v);
+      ASSERT_EQ(r->role_, Raft::kFollower);
+      ASSERT_EQ(r->Term(), 0);
+      ASSERT_TRUE(r->mails_.empty());
+    }
+  }
+
+  // TestJointConsensusRejectSimpleConfChange ensures that the voters of a joint
+  // configuration don't change until it's left, and that the commit index only
+  // counts the voters of the configurations.
+  static void TestJointConsensusRejectSimpleConfChange() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 10, 1, new MemoryStorage));
+    r->becomeCandidate();
+    r->becomeLeader();
+    r->EnterJoint({1, 2, 4});
+
+    for (auto type : {pb::ConfChangeAddNode, pb::ConfChangeAddLearnerNode,
+                      pb::ConfChangeRemoveNode, pb::ConfChangeBeginJoint}) {
+      auto cc = PBConfChange().Type(type).NodeId(3).v;
+      ASSERT_EQ(r->CheckConfChange(cc).Code(), Error::InvalidConfig);
+    }
+    ASSERT_OK(r->CheckConfChange(PBConfChange().Type(pb::ConfChangeLeaveJoint).v));
+
+    // the commit index doesn't re-insert a voter missing from the progresses.
+    r->prs_.erase(3);
+    r->mails_.clear();
+    ASSERT_FALSE(r->maybeCommit());
+    ASSERT_FALSE(r->HasPeer(3));
+    r->bcastAppend();
+    for (auto& m : r->mails_) {
+      ASSERT_NE(m.to(), 3);
+    }
+  }
+
+  // TestRestoreJointConfState restores a snapshot taken in a joint configuration.
+  static void TestRestoreJointConfState() {
+    auto s = PBSnapshot().MetaIndex(11).MetaTerm(11).MetaConfState({1, 4, 5}).v;
+    for (uint64_t id : {1, 2, 3}) {
+      s.mutable_metadata()->mutable_conf_state()->add_nodes_outgoing(id);
+    }
+
+    RaftUPtr r(newTestRaft(1, {1, 2}, 10, 1, new MemoryStorage));
+    ASSERT_TRUE(r->restore(s));
+    ASSERT_TRUE(r->IsJoint());
+    ASSERT_EQ(r->Peers(), std::set<uint64_t>({1, 2, 3, 4, 5}));
+    ASSERT_EQ(r->incoming_, std::set<uint64_t>({1, 4, 5}));
+    ASSERT_EQ(r->outgoing_, std::set<uint64_t>({1, 2, 3}));
+  }
+
+  // TestFastLogRejection ensures that the leader skips whole terms on a MsgApp
+  // rejection, using the conflicting term reported by the follower.
+  static void TestFastLogRejection() {
+    struct TestData {
+      EntryVec leaderLog;
+      EntryVec followerLog;
+      uint64_t rejectHintIndex;
+      uint64_t rejectHintTerm;
+      uint64_t nextAppendIndex;
+      uint64_t nextAppendTerm;
+    } tests[] = {
+        // The follower has a long suffix of a term unknown to the leader.
+        {{pbEntry(1, 1), pbEntry(2, 2), pbEntry(3, 2), pbEntry(4, 4), pbEntry(5, 4), pbEntry(6, 4),
+          pbEntry(7, 4)},
+         {pbEntry(1, 1), pbEntry(2, 2), pbEntry(3, 2), pbEntry(4, 3), pbEntry(5, 3), pbEntry(6, 3),
+          pbEntry(7, 3), pbEntry(8, 3), pbEntry(9, 3), pbEntry(10, 3), pbEntry(11, 3)},
+         7,
+         3,
+         3,
+         2},
+        // The leader has a long suffix of a term unknown to the follower.
+        {{pbEntry(1, 1), pbEntry(2, 2), pbEntry(3, 2), pbEntry(4, 4), pbEntry(5, 4), pbEntry(6, 4),
+          pbEntry(7, 4), pbEntry(8, 4), pbEntry(9, 4), pbEntry(10, 4), pbEntry(11, 4)},
+         {pbEntry(1, 1), pbEntry(2, 2), pbEntry(3, 2), pbEntry(4, 3), pbEntry(5, 3), pbEntry(6, 3),
+          pbEntry(7, 3)},
+         7,
+         3,
+         3,
+         2},
+        // The follower's log is a prefix of the leader's but short.
+        {{pbEntry(1, 1), pbEntry(2, 1), pbEntry(3, 1), pbEntry(4, 1), pbEntry(5, 1)},
+         {pbEntry(1, 1), pbEntry(2, 1)},
+         2,
+         1,
+         2,
+         1},
+    };
+
+    for (auto& t : tests) {
+      auto s1 = new MemoryStorage;
+      s1->Append(t.leaderLog);
+      RaftUPtr lead(newTestRaft(1, {1, 2}, 10, 1, s1));
+      lead->becomeFollower(4, 0);
+      lead->becomeCandidate();
+      lead->becomeLeader();
+      lead->mails_.clear();
+
+      auto s2 = new MemoryStorage;
+      s2->Append(t.followerLog);
+      RaftUPtr follower(newTestRaft(2, {1, 2}, 10, 1, s2));
+      follower->becomeFollower(lead->Term() - 1, 0);
+
+      // the leader probes from its last index.
+      uint64_t last = lead->log_->LastIndex();
+      lead->Step(PBMessage().From(2).To(1).Type(pb::MsgHeartbeatResp).Term(lead->Term()).v);
+      ASSERT_EQ(lead->mails_.size(), 1);
+      ASSERT_EQ(lead->mails_[0].index(), last);
+
+      follower->Step(lead->mails_[0]);
+      lead->mails_.clear();
+      ASSERT_EQ(follower->mails_.size(), 1);
+      auto resp = follower->mails_[0];
+      ASSERT_TRUE(resp.reject());
+      ASSERT_EQ(resp.rejecthint(), t.rejectHintIndex);
+      ASSERT_EQ(resp.logterm(), t.rejectHintTerm);
+
+      lead->Step(resp);
+      ASSERT_EQ(lead->mails_.size(), 1);
+      ASSERT_EQ(lead->mails_[0].index(), t.nextAppendIndex);
+      ASSERT_EQ(lead->mails_[0].logterm(), t.nextAppendTerm);
+    }
+  }
+
+  // TestCoalesceAppResp ensures that a follower queues a single MsgAppResp for a
+  // burst of accepted MsgApps, and never merges responses across a rejection.
+  static void TestCoalesceAppResp() {
+    RaftUPtr r(newTestRaft(2, {1, 2}, 10, 1, new MemoryStorage));
+    for (uint64_t i = 0; i < 100; i++) {
+      r->Step(PBMessage()
+                  .From(1)
+                  .To(2)
+                  .Type(pb::MsgApp)
+                  .Term(1)
+                  .Index(i)
+                  .LogTerm(i == 0 ? 0 : 1)
+                  .Entries({pbEntry(i + 1, 1)})
+                  .v);
+    }
+    ASSERT_EQ(r->mails_.size(), 1);
+    ASSERT_EQ(r->mails_[0].type(), pb::MsgAppResp);
+    ASSERT_EQ(r->mails_[0].index(), 100);
+
+    // a mismatched MsgApp is rejected.
+    r->Step(PBMessage().From(1).To(2).Type(pb::MsgApp).Term(1).Index(200).LogTerm(1).v);
+    r->Step(PBMessage()
+                .From(1)
+                .To(2)
+                .Type(pb::MsgApp)
+                .Term(1)
+                .Index(100)
+                .LogTerm(1)
+                .Entries({pbEntry(101, 1)})
+                .v);
+    ASSERT_EQ(r->mails_.size(), 3);
+    ASSERT_TRUE(r->mails_[1].reject());
+    ASSERT_EQ(r->mails_[2].index(), 101);
+  }
+
+  // TestCoalesceAppRespLeaderCounter ensures that the leader handles only one
+  // MsgAppResp for a pipelined burst of MsgApps.
+  static void TestCoalesceAppRespLeaderCounter() {
+    RaftUPtr lead(newTestRaft(1, {1, 2}, 10, 1, new MemoryStorage));
+    RaftUPtr follower(newTestRaft(2, {1, 2}, 10, 1, new MemoryStorage));
+    lead->becomeCandidate();
+    lead->becomeLeader();
+    lead->prs_[2].BecomeReplicate();
+    lead->mails_.clear();
+
+    for (int i = 0; i < 100; i++) {
+      lead->Step(PBMessage().From(1).To(1).Type(pb::MsgProp).Entries({PBEntry().Data("a").v}).v);
+    }
+    ASSERT_GE(lead->mails_.size(), 100);
+    for (auto& m : lead->mails_) {
+      follower->Step(m);
+    }
+    lead->mails_.clear();
+
+    ASSERT_EQ(follower->mails_.size(), 1);
+    for (auto& m : follower->mails_) {
+      lead->Step(m);
+    }
+    ASSERT_EQ(lead->prs_[2].AppResps(), 1);
+    ASSERT_EQ(lead->prs_[2].MatchIndex(), 100);
+    ASSERT_EQ(lead->log_->CommitIndex(), 100);
+  }
+
+  // TestLeaderStepdownWhenQuorumActive ensures that a leader keeps its leadership
+  // as long as a quorum of peers keeps responding within an election timeout.
+  static void TestLeaderStepdownWhenQuorumActive() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 5, 1, new MemoryStorage));
+    const_cast<Config*>(r->c_.get())->checkQuorum = true;
+    r->becomeCandidate();
+    r->becomeLeader();
+
+    for (int i = 0; i < 5 * 2 + 1; i++) {
+      r->Step(PBMessage().From(2).To(1).Type(pb::MsgHeartbeatResp).Term(r->Term()).v);
+      r->Tick();
+    }
+    ASSERT_EQ(r->role_, Raft::kLeader);
+  }
+
+  // TestLeaderStepdownWhenQuorumLost ensures that a leader steps down once it
+  // has not heard from a quorum for an election timeout.
+  static void TestLeaderStepdownWhenQuorumLost() {
+    RaftUPtr r(newTestRaft(1, {1, 2, 3}, 5, 1, new MemoryStorage));
+    const_cast<Config*>(r->c_.get())->checkQuorum = true;
+    r->becomeCandidate();
+    r->becomeLeader();
+
+    for (int i = 0; i < 5 + 1; i++) {
+      r->Tick();
+    }
+    ASSERT_EQ(r->role_, Raft::kFollower);
+    ASSERT_EQ(r->currentLeader_, 0);
+
+    // a follower drops proposals when no leader is known.
+    uint64_t lastIndex = r->log_->LastIndex();
+    r->Step(PBMessage().From(1).To(1).Type(pb::MsgProp).Entries({PBEntry().Data("data").v}).v);
+    ASSERT_EQ(r->log_->LastIndex(), lastIndex);
+  }
+
+  // TestLeaderIgnoresVoteInLease ensures that with checkQuorum enabled, a follower
+  // that has recently heard from the leader neither grants its vote nor advances
+  // its term.
+  static void TestLeaderIgnoresVoteInLease() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->SetCheckQuorum(true);
+
+    n->StartElection(1);
+    ASSERT_EQ(n->Peer(1)->role_, Raft::kLeader);
+
+    n->StartElection(3);
+    ASSERT_EQ(n->Peer(1)->role_, Raft::kLeader);
+    ASSERT_EQ(n->Peer(2)->role_, Raft::kFollower);
+    ASSERT_EQ(n->Peer(2)->Term(), 1);
+    ASSERT_EQ(n->Peer(3)->role_, Raft::kCandidate);
+  }
+
+  // TestFreeStuckCandidateWithCheckQuorum ensures that a candidate with a higher
+  // term can disrupt the leader even if the leader still "officially" holds the
+  // lease, the leader is expected to step down and adopt the candidate's term.
+  static void TestFreeStuckCandidateWithCheckQuorum() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->SetCheckQuorum(true);
+
+    n->StartElection(1);
+    ASSERT_EQ(n->Peer(1)->role_, Raft::kLeader);
+
+    n->Isolate(1);
+    n->StartElection(3);
+    ASSERT_EQ(n->Peer(2)->role_, Raft::kFollower);
+    ASSERT_EQ(n->Peer(3)->role_, Raft::kCandidate);
+    ASSERT_EQ(n->Peer(3)->Term(), n->Peer(2)->Term() + 1);
+
+    // Vote again for safety
+    n->StartElection(3);
+    ASSERT_EQ(n->Peer(2)->role_, Raft::kFollower);
+    ASSERT_EQ(n->Peer(3)->role_, Raft::kCandidate);
+    ASSERT_EQ(n->Peer(3)->Term(), n->Peer(2)->Term() + 2);
+
+    n->Recover();
+    n->Send(PBMessage().From(1).To(3).Type(pb::MsgHeartbeat).Term(n->Peer(1)->Term()).v);
+
+    // Disrupt the leader so that the stuck peer is freed
+    ASSERT_EQ(n->Peer(1)->role_, Raft::kFollower);
+    ASSERT_EQ(n->Peer(3)->Term(), n->Peer(1)->Term());
+  }
+
+  // TestProposalForwarding ensures that a follower forwards proposals to the leader,
+  // unless forwarding is disabled.
+  static void TestProposalForwarding(bool disableForwarding) {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->MutablePeerConfig(2)->disableProposalForwarding = disableForwarding;
+    n->StartElection(1);
+    ASSERT_EQ(n->Peer(1)->log_->CommitIndex(), 1);
+
+    n->Propose(2);
+    uint64_t wcommit = disableForwarding ? 1 : 2;
+    ASSERT_EQ(n->Peer(1)->log_->CommitIndex(), wcommit);
+    for (auto r : n->Peers()) {
+      ASSERT_EQ(r->log_->LastIndex(), wcommit);
+    }
+
+    // a follower with no leader drops the proposal.
+    n->Isolate(3);
+    n->StartElection(3);
+    n->Propose(3);
+    ASSERT_EQ(n->Peer(3)->log_->LastIndex(), wcommit);
+  }
+
+  // TestRandomizedElectionTimeout ensures that each raft draws its election
+  // timeout from [electionTick, 2 * electionTick) of its own config, and that
+  // a fixed seed reproduces the timeouts.
+  static void TestRandomizedElectionTimeout() {
+    auto newRaft = [](uint64_t id, int election, uint64_t seed) {
+      auto conf = newTestConfig(id, {1, 2, 3}, election, 1, new MemoryStorage());
+      conf->randomSeed = seed;
+      return RaftUPtr(new Raft(conf));
+    };
+
+    RaftUPtr r1 = newRaft(1, 10, 42), r2 = newRaft(1, 100, 42);
+    RaftUPtr r3 = newRaft(1, 10, 42), r4 = newRaft(2, 10, 42);
+    std::set<int> timeouts;
+    bool differ = false;
+    for (int i = 0; i < 1000; i++) {
+      r1->resetRandomizedElectionTimeout();
+      r2->resetRandomizedElectionTimeout();
+      r3->resetRandomizedElectionTimeout();
+      r4->resetRandomizedElectionTimeout();
+
+      ASSERT_GE(r1->randomizedElectionTimeout_, 10);
+      ASSERT_LT(r1->randomizedElectionTimeout_, 20);
+      ASSERT_GE(r2->randomizedElectionTimeout_, 100);
+      ASSERT_LT(r2->randomizedElectionTimeout_, 200);
+      ASSERT_EQ(r1->randomizedElectionTimeout_, r3->randomizedElectionTimeout_);
+      differ |= r1->randomizedElectionTimeout_ != r4->randomizedElectionTimeout_;
+      timeouts.insert(r1->randomizedElectionTimeout_);
+    }
+    // the peers sharing a seed don't time out together.
+    ASSERT_TRUE(differ);
+    ASSERT_EQ(timeouts.size(), 10);
+  }
+
+  static void checkLeaderTransferState(Raft* r, Raft::StateRole role, uint64_t lead) {
+    ASSERT_EQ(r->role_, role);
+    ASSERT_EQ(r->currentLeader_, lead);
+    ASSERT_EQ(r->leadTransferee_, 0);
+  }
+
+  static pb::Message transferLeaderMsg(uint64_t from, uint64_t to) {
+    return PBMessage().From(from).To(to).Type(pb::MsgTransferLeader).v;
+  }
+
+  // TestLeaderTransferToUpToDateNode verifies transferring should succeed
+  // if the transferee has the most up-to-date log entries when transfer starts.
+  static void TestLeaderTransferToUpToDateNode(bool checkQuorum) {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->SetCheckQuorum(checkQuorum);
+    n->StartElection(1);
+
+    Raft* lead = n->Peer(1);
+    ASSERT_EQ(lead->currentLeader_, 1);
+
+    // Transfer leadership to 2.
+    n->Send(transferLeaderMsg(2, 1));
+    checkLeaderTransferState(lead, Raft::kFollower, 2);
+
+    // After some log replication, transfer leadership back to 1.
+    n->Propose(1);
+    n->Send(transferLeaderMsg(1, 2));
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+  }
+
+  // TestLeaderTransferToUpToDateNodeFromFollower verifies transferring should succeed
+  // if the transferee has the most up-to-date log entries when transfer starts.
+  // Not like TestLeaderTransferToUpToDateNode, where the leader transfer message
+  // is sent to the leader, in this test case every leader transfer message is sent
+  // to the follower.
+  static void TestLeaderTransferToUpToDateNodeFromFollower() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+
+    Raft* lead = n->Peer(1);
+
+    n->Send(transferLeaderMsg(2, 2));
+    checkLeaderTransferState(lead, Raft::kFollower, 2);
+
+    n->Propose(2);
+    n->Send(transferLeaderMsg(1, 1));
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+  }
+
+  static void TestLeaderTransferToSlowFollower() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+
+    n->Isolate(3);
+    n->Propose(1);
+    n->Recover();
+
+    Raft* lead = n->Peer(1);
+    ASSERT_EQ(lead->prs_[3].MatchIndex(), 1);
+
+    // Transfer leadership to 3 when node 3 is lack of log.
+    n->Send(transferLeaderMsg(3, 1));
+    checkLeaderTransferState(lead, Raft::kFollower, 3);
+  }
+
+  static void TestLeaderTransferWithPreVote() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->SetPreVote(true);
+    n->StartElection(1);
+
+    // Leadership transfers bypass pre-vote.
+    n->Send(transferLeaderMsg(3, 1));
+    checkLeaderTransferState(n->Peer(1), Raft::kFollower, 3);
+    ASSERT_EQ(n->Peer(3)->role_, Raft::kLeader);
+    ASSERT_EQ(n->Peer(3)->Term(), 2);
+  }
+
+  static void TestLeaderTransferToSelf() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+
+    // Transfer leadership to self, there will be noop.
+    n->Send(transferLeaderMsg(1, 1));
+    checkLeaderTransferState(n->Peer(1), Raft::kLeader, 1);
+  }
+
+  static void TestLeaderTransferTimeout() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+    n->Isolate(3);
+
+    Raft* lead = n->Peer(1);
+
+    // Transfer leadership to isolated node, wait for timeout.
+    lead->Step(PBMessage().From(3).To(1).Type(pb::MsgTransferLeader).v);
+    ASSERT_EQ(lead->leadTransferee_, 3);
+
+    for (int i = 0; i < lead->c_->heartbeatTick; i++) {
+      lead->Tick();
+    }
+    ASSERT_EQ(lead->leadTransferee_, 3);
+
+    for (int i = 0; i < lead->c_->electionTick - lead->c_->heartbeatTick; i++) {
+      lead->Tick();
+    }
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+  }
+
+  static void TestLeaderTransferIgnoreProposal() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+    n->Isolate(3);
+
+    Raft* lead = n->Peer(1);
+
+    // Transfer leadership to isolated node to let transfer pending, then send proposal.
+    lead->Step(PBMessage().From(3).To(1).Type(pb::MsgTransferLeader).v);
+    ASSERT_EQ(lead->leadTransferee_, 3);
+
+    n->Propose(1);
+    ASSERT_EQ(lead->log_->LastIndex(), 1);
+    ASSERT_EQ(lead->prs_[1].MatchIndex(), 1);
+  }
+
+  static void TestLeaderTransferSecondTransferToAnotherNode() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+    n->Isolate(3);
+
+    Raft* lead = n->Peer(1);
+
+    lead->Step(PBMessage().From(3).To(1).Type(pb::MsgTransferLeader).v);
+    ASSERT_EQ(lead->leadTransferee_, 3);
+
+    // Transfer leadership to another node.
+    n->Send(transferLeaderMsg(2, 1));
+    checkLeaderTransferState(lead, Raft::kFollower, 2);
+  }
+
+  // TestLeaderTransferSecondTransferToSameNode verifies second transfer leader request
+  // to the same node should not extend the timeout while the first one is pending.
+  static void TestLeaderTransferSecondTransferToSameNode() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+    n->Isolate(3);
+
+    Raft* lead = n->Peer(1);
+
+    lead->Step(PBMessage().From(3).To(1).Type(pb::MsgTransferLeader).v);
+    ASSERT_EQ(lead->leadTransferee_, 3);
+
+    for (int i = 0; i < lead->c_->heartbeatTick; i++) {
+      lead->Tick();
+    }
+    // Second transfer leadership request to the same node.
+    lead->Step(PBMessage().From(3).To(1).Type(pb::MsgTransferLeader).v);
+
+    for (int i = 0; i < lead->c_->electionTick - lead->c_->heartbeatTick; i++) {
+      lead->Tick();
+    }
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+  }
+
+  // TestLeaderTransferRemoveNode verifies that removing the transferee aborts
+  // the pending transfer, so that proposals are accepted again.
+  static void TestLeaderTransferRemoveNode() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+    n->Isolate(3);
+
+    Raft* lead = n->Peer(1);
+
+    lead->Step(PBMessage().From(3).To(1).Type(pb::MsgTransferLeader).v);
+    ASSERT_EQ(lead->leadTransferee_, 3);
+
+    lead->RemoveNode(3);
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+  }
+
+  // TestLeaderTransferForwardedToNonVoter ensures that the leader ignores a
+  // transfer forwarded by a follower whose configuration is ahead of its own,
+  // to a node it doesn't know or knows only as a learner.
+  static void TestLeaderTransferForwardedToNonVoter() {
+    std::unique_ptr<Network> n(Network::New(3));
+    n->StartElection(1);
+
+    Raft* lead = n->Peer(1);
+    n->Peer(2)->AddNode(4);
+    n->Send(transferLeaderMsg(4, 2));
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+
+    lead->AddLearner(5);
+    n->Peer(2)->AddNode(5);
+    n->Send(transferLeaderMsg(5, 2));
+    checkLeaderTransferState(lead, Raft::kLeader, 1);
+  }
 };
 
 }  // namespace yaraft
@@ -746,7 +1542,11 @@ TEST_F(RaftTest, RestoreIgnoreSnapshot) {
 }
 
 TEST_F(RaftTest, ProvideSnap) {
-  RaftTest::TestProvideSnap();
+  RaftTest::TestProvideSnap(false);
+}
+
+TEST_F(RaftTest, ProvideDetachedSnap) {
+  RaftTest::TestProvideSnap(true);
 }
 
 TEST_F(RaftTest, ProgressResumeByHeartbeatResp) {
@@ -775,4 +1575,148 @@ TEST_F(RaftTest, AddNode) {
 
 TEST_F(RaftTest, RemoveNode) {
   RaftTest::TestRemoveNode();
-}
\ No newline at end of file
+}
+
+TEST_F(RaftTest, AddLearner) {
+  RaftTest::TestAddLearner();
+}
+
+TEST_F(RaftTest, LearnerElectionTimeout) {
+  RaftTest::TestLearnerElectionTimeout();
+}
+
+TEST_F(RaftTest, LearnerCannotVote) {
+  RaftTest::TestLearnerCannotVote();
+}
+
+TEST_F(RaftTest, LearnerLogReplication) {
+  RaftTest::TestLearnerLogReplication();
+}
+
+TEST_F(RaftTest, LearnerPromotion) {
+  RaftTest::TestLearnerPromotion();
+}
+
+TEST_F(RaftTest, LearnerRecentActive) {
+  RaftTest::TestLearnerRecentActive();
+}
+
+TEST_F(RaftTest, RestoreWithLearner) {
+  RaftTest::TestRestoreWithLearner();
+}
+
+TEST_F(RaftTest, JointConsensusCommit) {
+  RaftTest::TestJointConsensusCommit();
+}
+
+TEST_F(RaftTest, JointConsensusElection) {
+  RaftTest::TestJointConsensusElection();
+}
+
+TEST_F(RaftTest, JointConsensusAutoLeave) {
+  RaftTest::TestJointConsensusAutoLeave();
+}
+
+TEST_F(RaftTest, JointConsensusRemoveLeader) {
+  RaftTest::TestJointConsensusRemoveLeader();
+}
+
+TEST_F(RaftTest, RemovedNodeNeverCampaigns) {
+  RaftTest::TestRemovedNodeNeverCampaigns();
+}
+
+TEST_F(RaftTest, JointConsensusRejectSimpleConfChange) {
+  RaftTest::TestJointConsensusRejectSimpleConfChange();
+}
+
+TEST_F(RaftTest, RestoreJointConfState) {
+  RaftTest::TestRestoreJointConfState();
+}
+
+TEST_F(RaftTest, FastLogRejection) {
+  RaftTest::TestFastLogRejection();
+}
+
+TEST_F(RaftTest, CoalesceAppResp) {
+  RaftTest::TestCoalesceAppResp();
+}
+
+TEST_F(RaftTest, CoalesceAppRespLeaderCounter) {
+  RaftTest::TestCoalesceAppRespLeaderCounter();
+}
+
+TEST_F(RaftTest, LeaderStepdownWhenQuorumActive) {
+  RaftTest::TestLeaderStepdownWhenQuorumActive();
+}
+
+TEST_F(RaftTest, LeaderStepdownWhenQuorumLost) {
+  RaftTest::TestLeaderStepdownWhenQuorumLost();
+}
+
+TEST_F(RaftTest, LeaderIgnoresVoteInLease) {
+  RaftTest::TestLeaderIgnoresVoteInLease();
+}
+
+TEST_F(RaftTest, FreeStuckCandidateWithCheckQuorum) {
+  RaftTest::TestFreeStuckCandidateWithCheckQuorum();
+}
+
+TEST_F(RaftTest, LeaderTransferToUpToDateNode) {
+  RaftTest::TestLeaderTransferToUpToDateNode(false);
+}
+
+TEST_F(RaftTest, LeaderTransferToUpToDateNodeWithCheckQuorum) {
+  RaftTest::TestLeaderTransferToUpToDateNode(true);
+}
+
+TEST_F(RaftTest, LeaderTransferToUpToDateNodeFromFollower) {
+  RaftTest::TestLeaderTransferToUpToDateNodeFromFollower();
+}
+
+TEST_F(RaftTest, LeaderTransferToSlowFollower) {
+  RaftTest::TestLeaderTransferToSlowFollower();
+}
+
+TEST_F(RaftTest, LeaderTransferWithPreVote) {
+  RaftTest::TestLeaderTransferWithPreVote();
+}
+
+TEST_F(RaftTest, LeaderTransferToSelf) {
+  RaftTest::TestLeaderTransferToSelf();
+}
+
+TEST_F(RaftTest, LeaderTransferTimeout) {
+  RaftTest::TestLeaderTransferTimeout();
+}
+
+TEST_F(RaftTest, LeaderTransferIgnoreProposal) {
+  RaftTest::TestLeaderTransferIgnoreProposal();
+}
+
+TEST_F(RaftTest, LeaderTransferSecondTransferToAnotherNode) {
+  RaftTest::TestLeaderTransferSecondTransferToAnotherNode();
+}
+
+TEST_F(RaftTest, LeaderTransferSecondTransferToSameNode) {
+  RaftTest::TestLeaderTransferSecondTransferToSameNode();
+}
+
+TEST_F(RaftTest, LeaderTransferRemoveNode) {
+  RaftTest::TestLeaderTransferRemoveNode();
+}
+
+TEST_F(RaftTest, LeaderTransferForwardedToNonVoter) {
+  RaftTest::TestLeaderTransferForwardedToNonVoter();
+}
+
+TEST_F(RaftTest, ProposalForwarding) {
+  RaftTest::TestProposalForwarding(false);
+}
+
+TEST_F(RaftTest, DisableProposalForwarding) {
+  RaftTest::TestProposalForwarding(true);
+}
+
+TEST_F(RaftTest, RandomizedElectionTimeout) {
+  RaftTest::TestRandomizedElectionTimeout();
+}
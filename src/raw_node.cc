@@ -49,6 +49,30 @@ bool operator!=(const pb::HardState& a, const pb::HardState& b) {
     }                                                                                      \
   } while (0)
 
+// Followers forward proposals to the leader unless Config::disableProposalForwarding
+// is set, in which case, as well as when no leader is known, only the leader accepts them.
+#define RETURN_IF_CANNOT_FORWARD                                                              \
+  do {                                                                                        \
+    if (!IsLeader()) {                                                                        \
+      if (raft_->c_->disableProposalForwarding) {                                             \
+        return Status::Make(Error::NotLeader, fmt::format("{} is not leader", raft_->Id()));  \
+      }                                                                                       \
+      if (LeaderHint() == 0) {                                                                \
+        return Status::Make(Error::NotLeader,                                                 \
+                            fmt::format("{} has no leader to forward to", raft_->Id()));      \
+      }                                                                                       \
+    }                                                                                         \
+  } while (0)
+
+#define RETURN_IF_TRANSFERRING_LEADER                                                    \
+  do {                                                                                   \
+    if (raft_->leadTransferee_ != 0) {                                                   \
+      return Status::Make(Error::ProposalDropped,                                        \
+                          fmt::format("{} is transferring leadership to {}", raft_->Id(), \
+                                      raft_->leadTransferee_));                          \
+    }                                                                                    \
+  } while (0)
+
 RawNode::RawNode(Config* conf) : prevHardState_(new pb::HardState) {
   // validate first to avoid bad config (which may cause crazy segfault).
   FATAL_NOT_OK(conf->Validate(), "Config::Validate");
@@ -68,7 +92,7 @@ Status RawNode::Step(pb::Message& m) {
     return Status::Make(Error::StepLocalMsg, "cannot step raft local message");
   }
 
-  if (!raft_->HasPeer(m.from()) && IsResponseMsg(m)) {
+  if (!raft_->HasPeer(m.from()) && !raft_->HasLearner(m.from()) && IsResponseMsg(m)) {
     return Status::Make(Error::StepPeerNotFound,
                         "cannot step a response message from peer not found");
   }
@@ -76,8 +100,27 @@ Status RawNode::Step(pb::Message& m) {
   return raft_->Step(m);
 }
 
+Status RawNode::StepBatch(std::vector<pb::Message>& msgs) {
+  Status ret = Status::OK();
+  raft_->DeferCommit(true);
+  for (auto& m : msgs) {
+    // commit before anything else may depend on it, or change the term.
+    if (m.type() != pb::MsgAppResp || m.term() != raft_->Term()) {
+      raft_->FlushCommit();
+    }
+
+    Status s = Step(m);
+    if (!s.IsOK() && ret.IsOK()) {
+      ret = s;
+    }
+  }
+  raft_->DeferCommit(false);
+  return ret;
+}
+
 Status RawNode::Propose(const silly::Slice& data) {
-  RETURN_IF_NOT_LEADER;
+  RETURN_IF_CANNOT_FORWARD;
+  RETURN_IF_TRANSFERRING_LEADER;
 
   uint64_t id = raft_->Id(), term = raft_->Term();
   auto e = PBEntry().Data(data).v;
@@ -89,10 +132,41 @@ Status RawNode::Campaign() {
   return raft_->Step(PBMessage().From(id).To(id).Type(pb::MsgHup).Term(term).v);
 }
 
+// batchMessages groups `msgs` by destination. The redundant MsgAppResps have
+// already been merged by Raft::send.
+static std::vector<pb::MessageBatch> batchMessages(std::vector<pb::Message>* msgs) {
+  std::vector<pb::MessageBatch> batches;
+  std::unordered_map<uint64_t, size_t> batchOf;
+  for (auto& m : *msgs) {
+    auto it = batchOf.find(m.to());
+    if (it == batchOf.end()) {
+      it = batchOf.emplace(m.to(), batches.size()).first;
+      batches.emplace_back();
+    }
+    batches[it->second].add_messages()->Swap(&m);
+  }
+  return batches;
+}
+
 Ready* RawNode::GetReady() {
+  // send out the read only requests batched in this cycle.
+  raft_->flushReadIndex();
+
   std::unique_ptr<Ready> rd(new Ready);
-  rd->entries = std::move(raft_->log_->GetUnstable().entries);
-  rd->messages = std::move(raft_->mails_);
+  // The unstable entries are handed over to the application, which is required
+  // to persist them (Ready::Advance) before the next step.
+  Unstable& unstable = raft_->log_->GetUnstable();
+  unstable.StableAll(&rd->entries);
+  if (raft_->c_->batchMessages) {
+    rd->batches = batchMessages(&raft_->mails_);
+  } else {
+    rd->messages = std::move(raft_->mails_);
+  }
+  raft_->mails_.clear();
+  rd->msgSnapshots = std::move(raft_->msgSnapshots_);
+  raft_->msgSnapshots_.clear();
+  rd->readStates = std::move(raft_->readStates_);
+  raft_->readStates_.clear();
 
   pb::HardState hs = PBHardState()
                          .Vote(raft_->votedFor_)
@@ -112,17 +186,38 @@ Ready* RawNode::GetReady() {
   return rd.release();
 }
 
-void RawNode::ReportSnapshot(uint64_t id, RawNode::SnapshotStatus status) {
+void RawNode::ReportSnapshot(uint64_t id, SnapshotStatus status) {
+  if (!raft_->HasPeer(id) && !raft_->HasLearner(id)) {
+    return;
+  }
   bool reject = status == kSnapshotFailure;
   raft_->Step(PBMessage().Type(pb::MsgSnapStatus).From(id).To(id).Reject(reject).v);
 }
 
 void RawNode::ReportUnreachable(uint64_t id) {
+  if (!raft_->HasPeer(id) && !raft_->HasLearner(id)) {
+    return;
+  }
   raft_->Step(PBMessage().Type(pb::MsgUnreachable).From(id).To(id).v);
 }
 
 pb::ConfState RawNode::ApplyConfChange(const pb::ConfChange& cc) {
-  pb::ConfState confState;
+  Status s = raft_->CheckConfChange(cc);
+  if (!s.IsOK()) {
+    FMT_SLOG(WARNING, "%x ignored conf change %s: %s", raft_->Id(),
+             pb::ConfChangeType_Name(cc.type()), s.ToString());
+    raft_->pendingConf_ = false;
+    return raft_->CurrentConfState();
+  }
+
+  if (cc.type() == pb::ConfChangeBeginJoint) {
+    raft_->EnterJoint(std::vector<uint64_t>(cc.voters().begin(), cc.voters().end()));
+    return raft_->CurrentConfState();
+  } else if (cc.type() == pb::ConfChangeLeaveJoint) {
+    raft_->LeaveJoint();
+    return raft_->CurrentConfState();
+  }
+
   if (!cc.has_nodeid() || cc.nodeid() == 0) {
     FMT_LOG(FATAL, "what???");
   }
@@ -131,6 +226,9 @@ pb::ConfState RawNode::ApplyConfChange(const pb::ConfChange& cc) {
     case pb::ConfChangeAddNode:
       raft_->AddNode(cc.nodeid());
       break;
+    case pb::ConfChangeAddLearnerNode:
+      raft_->AddLearner(cc.nodeid());
+      break;
     case pb::ConfChangeRemoveNode:
       raft_->RemoveNode(cc.nodeid());
       break;
@@ -138,12 +236,17 @@ pb::ConfState RawNode::ApplyConfChange(const pb::ConfChange& cc) {
       FMT_LOG(FATAL, "unexpected conf type");
   }
 
-  confState.add_nodes(cc.nodeid());
-  return confState;
+  return raft_->CurrentConfState();
 }
 
 Status RawNode::ProposeConfChange(const pb::ConfChange& cc) {
   RETURN_IF_NOT_LEADER;
+  RETURN_IF_TRANSFERRING_LEADER;
+
+  Status s = raft_->CheckConfChange(cc);
+  if (!s.IsOK()) {
+    return s;
+  }
 
   return raft_->Step(
       PBMessage()
@@ -174,22 +277,39 @@ uint64_t RawNode::LeaderHint() const {
   return raft_->currentLeader_;
 }
 
+uint64_t RawNode::LeadTransferee() const {
+  return raft_->leadTransferee_;
+}
+
+Status RawNode::TransferLeader(uint64_t transferee) {
+  if (!raft_->HasPeer(transferee)) {
+    return Status::Make(Error::StepPeerNotFound,
+                        fmt::format("transferee {} is not a voting member", transferee));
+  }
+
+  return raft_->Step(PBMessage().Type(pb::MsgTransferLeader).From(transferee).v);
+}
+
 std::unordered_map<uint64_t, RaftProgress> RawNode::ProgressMap() {
   std::unordered_map<uint64_t, RaftProgress> result;
-  for (auto e : raft_->prs_) {
-    result[e.first] = RaftProgress(e.second.NextIndex(), e.second.MatchIndex());
-  }
+  raft_->forEachProgress([&](uint64_t id, const Progress& pr) {
+    result[id] = RaftProgress(pr.NextIndex(), pr.MatchIndex(), pr.AppResps());
+  });
   return result;
 }
 
-Status RawNode::ReadIndex(std::string& ctx) {
-  // no forwarding supports.
-  // no follower read supports.
-  RETURN_IF_NOT_LEADER;
+StatusWith<uint64_t> RawNode::ReadIndex() {
+  RETURN_IF_CANNOT_FORWARD;
 
-  raft_->Step(PBMessage().Type(pb::MsgReadIndex).Entries({PBEntry().Data(ctx).v}).v);
+  uint64_t id = raft_->nextReadRequestId();
+  raft_->Step(PBMessage()
+                  .From(raft_->Id())
+                  .To(raft_->Id())
+                  .Type(pb::MsgReadIndex)
+                  .Context(new std::string(EncodeReadContext(id)))
+                  .v);
 
-  return Status::OK();
+  return StatusWith<uint64_t>(id);
 }
 
 }  // namespace yaraft
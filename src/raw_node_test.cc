@@ -147,4 +147,191 @@ TEST_F(RawNodeTest, ProposeAddDuplicateNode) {
     ASSERT_EQ(actual[2].type(), pb::EntryConfChange);
     ASSERT_EQ(actual[3].type(), pb::EntryConfChange);
   }
-}
\ No newline at end of file
+}
+
+TEST_F(RawNodeTest, TransferLeaderBlocksProposal) {
+  auto memstore = new MemoryStorage();
+  RawNode rn(newTestConfig(1, {1, 2}, 10, 1, memstore));
+  ASSERT_OK(rn.Campaign());
+  rn.Step(PBMessage().From(2).To(1).Type(pb::MsgVoteResp).Term(rn.CurrentTerm()).v);
+  ASSERT_TRUE(rn.IsLeader());
+
+  ASSERT_EQ(rn.TransferLeader(3).Code(), Error::StepPeerNotFound);
+
+  // node 2 hasn't acknowledged any entry, so the transfer stays pending.
+  ASSERT_OK(rn.TransferLeader(2));
+  ASSERT_EQ(rn.LeadTransferee(), 2);
+  ASSERT_EQ(rn.Propose("a").Code(), Error::ProposalDropped);
+
+  // the transfer is aborted after an election timeout.
+  for (int i = 0; i < 10; i++) {
+    rn.Tick();
+  }
+  ASSERT_EQ(rn.LeadTransferee(), 0);
+  ASSERT_OK(rn.Propose("a"));
+}
+
+TEST_F(RawNodeTest, ProposeWithoutLeader) {
+  RawNode rn(newTestConfig(1, {1, 2}, 10, 1, new MemoryStorage()));
+  ASSERT_EQ(rn.Propose("a").Code(), Error::NotLeader);
+}
+
+// This test ensures that RawNode::ReadIndex hands the read state over to the
+// application through Ready.
+TEST_F(RawNodeTest, ReadIndex) {
+  auto memstore = new MemoryStorage();
+  RawNode rn(newTestConfig(1, {1}, 10, 1, memstore));
+  ASSERT_OK(rn.Campaign());
+  Ready* rd = rn.GetReady();
+  rd->Advance(memstore);
+  delete rd;
+
+  auto sw = rn.ReadIndex();
+  ASSERT_OK(sw);
+
+  rd = rn.GetReady();
+  ASSERT_TRUE(rd != nullptr);
+  ASSERT_EQ(rd->readStates.size(), 1);
+  ASSERT_EQ(rd->readStates[0].index, 1);
+  ASSERT_EQ(rd->readStates[0].requestId, sw.GetValue());
+  delete rd;
+
+  // read states are handed over only once.
+  ASSERT_TRUE(rn.GetReady() == nullptr);
+}
+
+// This test ensures that with batchMessages the messages in Ready are grouped
+// by destination.
+TEST_F(RawNodeTest, BatchMessages) {
+  auto memstore = new MemoryStorage();
+  auto conf = newTestConfig(1, {1, 2, 3}, 10, 1, memstore);
+  conf->batchMessages = true;
+  RawNode rn(conf);
+  ASSERT_OK(rn.Campaign());
+
+  Ready* rd = rn.GetReady();
+  ASSERT_TRUE(rd->messages.empty());
+  ASSERT_EQ(rd->batches.size(), 2);
+  std::set<uint64_t> dests;
+  for (auto& batch : rd->batches) {
+    ASSERT_EQ(batch.messages_size(), 1);
+    ASSERT_EQ(batch.messages(0).type(), pb::MsgVote);
+    dests.insert(batch.messages(0).to());
+  }
+  ASSERT_EQ(dests, std::set<uint64_t>({2, 3}));
+  rd->Advance(memstore);
+  delete rd;
+}
+
+// This test ensures that the accepted MsgAppResps of a follower in one Ready
+// are merged into the one with the highest index.
+TEST_F(RawNodeTest, BatchMessagesMergeAppResp) {
+  auto memstore = new MemoryStorage();
+  auto conf = newTestConfig(2, {1, 2}, 10, 1, memstore);
+  conf->batchMessages = true;
+  RawNode rn(conf);
+
+  ASSERT_OK(rn.Step(PBMessage()
+                        .From(1)
+                        .To(2)
+                        .Type(pb::MsgApp)
+                        .Term(1)
+                        .Index(0)
+                        .LogTerm(0)
+                        .Entries({pbEntry(1, 1)})
+                        .v));
+  ASSERT_OK(rn.Step(PBMessage().From(1).To(2).Type(pb::MsgHeartbeat).Term(1).v));
+  ASSERT_OK(rn.Step(PBMessage()
+                        .From(1)
+                        .To(2)
+                        .Type(pb::MsgApp)
+                        .Term(1)
+                        .Index(1)
+                        .LogTerm(1)
+                        .Entries({pbEntry(2, 1)})
+                        .v));
+
+  Ready* rd = rn.GetReady();
+  ASSERT_EQ(rd->batches.size(), 1);
+  auto& batch = rd->batches[0];
+  ASSERT_EQ(batch.messages_size(), 2);
+  ASSERT_EQ(batch.messages(0).type(), pb::MsgAppResp);
+  ASSERT_EQ(batch.messages(0).index(), 2);
+  ASSERT_EQ(batch.messages(1).type(), pb::MsgHeartbeatResp);
+  rd->Advance(memstore);
+  delete rd;
+}
+
+// This test ensures that StepBatch advances the commit index as Step does,
+// but broadcasts it once for the MsgAppResps stepped in a row.
+TEST_F(RawNodeTest, StepBatch) {
+  auto newLeader = [](MemoryStorage* memstore) {
+    RawNode* rn = new RawNode(newTestConfig(1, {1, 2, 3}, 10, 1, memstore));
+    rn->Campaign();
+    for (uint64_t id : {2, 3}) {
+      rn->Step(PBMessage().From(id).To(1).Term(1).Type(pb::MsgVoteResp).v);
+    }
+    std::unique_ptr<Ready>(rn->GetReady())->Advance(memstore);
+    for (uint64_t id : {2, 3}) {
+      rn->Step(PBMessage().From(id).To(1).Term(1).Type(pb::MsgAppResp).Index(1).v);
+    }
+    std::unique_ptr<Ready>(rn->GetReady())->Advance(memstore);
+    // each proposal is sent in its own MsgApp.
+    for (int i = 0; i < 3; i++) {
+      rn->Propose("a");
+      std::unique_ptr<Ready>(rn->GetReady())->Advance(memstore);
+    }
+    return std::unique_ptr<RawNode>(rn);
+  };
+  auto appResps = [](uint64_t from) {
+    std::vector<pb::Message> msgs;
+    for (uint64_t i = 2; i <= 4; i++) {
+      msgs.push_back(PBMessage().From(from).To(1).Term(1).Type(pb::MsgAppResp).Index(i).v);
+    }
+    return msgs;
+  };
+  auto countMsgApp = [](Ready* rd) {
+    return std::count_if(rd->messages.begin(), rd->messages.end(),
+                         [](const pb::Message& m) { return m.type() == pb::MsgApp; });
+  };
+
+  auto memstore1 = new MemoryStorage, memstore2 = new MemoryStorage;
+  auto rn1 = newLeader(memstore1), rn2 = newLeader(memstore2);
+  ASSERT_EQ(rn1->CommittedIndex(), 1);
+
+  for (auto& m : appResps(2)) {
+    ASSERT_OK(rn1->Step(m));
+  }
+  std::unique_ptr<Ready> rd1(rn1->GetReady());
+  ASSERT_EQ(rn1->CommittedIndex(), 4);
+  ASSERT_EQ(countMsgApp(rd1.get()), 3 * 2);
+
+  auto msgs = appResps(2);
+  // the rejected ones are skipped.
+  msgs.insert(msgs.begin(), PBMessage().From(1).To(1).Type(pb::MsgHup).v);
+  ASSERT_EQ(rn2->StepBatch(msgs).Code(), Error::StepLocalMsg);
+  std::unique_ptr<Ready> rd2(rn2->GetReady());
+  ASSERT_EQ(rn2->CommittedIndex(), 4);
+  ASSERT_EQ(countMsgApp(rd2.get()), 1 * 2);
+  ASSERT_EQ(rd2->messages.back().commit(), 4);
+}
+
+// This test ensures that a conf change that makes the voters more than
+// kMaxVoters is rejected, both when proposed and when applied.
+TEST_F(RawNodeTest, ConfChangeTooManyVoters) {
+  auto memstore = new MemoryStorage();
+  RawNode rn(newTestConfig(1, {1}, 10, 1, memstore));
+  ASSERT_OK(rn.Campaign());
+  for (uint64_t id = 2; id <= kMaxVoters; id++) {
+    rn.ApplyConfChange(PBConfChange().Type(pb::ConfChangeAddNode).NodeId(id).v);
+  }
+  ASSERT_TRUE(rn.IsLeader());
+
+  auto cc = PBConfChange().Type(pb::ConfChangeAddNode).NodeId(kMaxVoters + 1).v;
+  ASSERT_EQ(rn.ProposeConfChange(cc).Code(), Error::InvalidConfig);
+  ASSERT_EQ(rn.ApplyConfChange(cc).nodes_size(), kMaxVoters);
+
+  // adding an existing voter is fine.
+  cc = PBConfChange().Type(pb::ConfChangeAddNode).NodeId(2).v;
+  ASSERT_OK(rn.ProposeConfChange(cc));
+}
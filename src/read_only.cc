@@ -21,63 +21,99 @@
 
 namespace yaraft {
 
-void ReadOnly::AddRequest(uint64_t idx, const pb::Message &m) {
-  std::string ctx = m.entries(0).data();
-  if (pendingReadIndex.find(ctx) != pendingReadIndex.end()) {
-    return;
-  }
+static const size_t kInitialRingSize = 16;
+
+// each peer acks a read only request in its own bit of ReadIndexStatus::acks.
+static_assert(sizeof(ReadIndexStatus::acks) * 8 == kMaxVoters,
+              "ReadIndexStatus::acks must have a bit for each voter");
+
+ReadOnly::ReadOnly() : ring_(kInitialRingSize), head_(1), tail_(1), usedSlots_(0) {}
 
-  ReadIndexStatus rdIdx;
-  rdIdx.index = idx;
+uint64_t ReadOnly::AddRequest(uint64_t idx, std::vector<ReadRequest> *reqs) {
+  if (PendingSize() == ring_.size()) {
+    grow();
+  }
 
-  pendingReadIndex[ctx] = rdIdx;
-  readIndexQueue.emplace_back(ctx);
+  uint64_t seq = tail_++;
+  ReadIndexStatus &rs = slot(seq);
+  rs.index = idx;
+  rs.acks = 0;
+  rs.reqs.swap(*reqs);
+  reqs->clear();
+  return seq;
 }
 
 int ReadOnly::RecvAck(const pb::Message &m) {
-  auto it = pendingReadIndex.find(m.context());
-  if (it == pendingReadIndex.end()) {
+  uint64_t seq = DecodeReadContext(m.context());
+  if (!isPending(seq)) {
     return 0;
   }
 
-  it->second.acks.insert(m.from());
+  ReadIndexStatus &rs = slot(seq);
+  int s = peerSlot(m.from());
+  if (LIKELY(s >= 0)) {
+    rs.acks |= uint64_t(1) << s;
+  }
 
   // add one to include an ack from local node
-  return static_cast<int>(it->second.acks.size());
+  return __builtin_popcountll(rs.acks) + 1;
 }
 
-void ReadOnly::Advance(const pb::Message &m, std::vector<ReadState> *readStates) {
-  int i = 0;
-  bool found = false;
-  const std::string &ctx = m.context();
+bool ReadOnly::Acked(const pb::Message &m, uint64_t id) const {
+  uint64_t seq = DecodeReadContext(m.context());
+  auto it = peerSlots_.find(id);
+  if (!isPending(seq) || it == peerSlots_.end()) {
+    return false;
+  }
+  return (ring_[seq & (ring_.size() - 1)].acks >> it->second) & 1;
+}
 
-  for (; i < readIndexQueue.size(); i++) {
-    const std::string &okctx = readIndexQueue[i];
+void ReadOnly::Reset() {
+  for (; head_ < tail_; head_++) {
+    slot(head_).reqs.clear();
+  }
+  peerSlots_.clear();
+  usedSlots_ = 0;
+}
 
-    // TODO(wutao1): Remove this when code is stable
-    DLOG_ASSERT_S(pendingReadIndex.find(okctx) != pendingReadIndex.end(),
-                  "cannot find corresponding read state from pending map")
+void ReadOnly::RemovePeer(uint64_t id) {
+  auto it = peerSlots_.find(id);
+  if (it == peerSlots_.end()) {
+    return;
+  }
 
-    if (ctx == okctx) {
-      found = true;
-      break;
-    }
+  uint64_t mask = ~(uint64_t(1) << it->second);
+  for (uint64_t seq = head_; seq < tail_; seq++) {
+    slot(seq).acks &= mask;
   }
+  usedSlots_ &= mask;
+  peerSlots_.erase(it);
+}
 
-  if (found) {
-    // assert readIndexQueue[i] == m.context()
-    for (int k = 0; k <= i; k++) {
-      ReadState state;
-      state.requestCtx = std::move(readIndexQueue[k]);
+int ReadOnly::peerSlot(uint64_t id) {
+  auto it = peerSlots_.find(id);
+  if (LIKELY(it != peerSlots_.end())) {
+    return it->second;
+  }
 
-      auto it = pendingReadIndex.find(state.requestCtx);
-      state.index = it->second.index;
+  if (UNLIKELY(~usedSlots_ == 0)) {
+    // unreachable as long as the voters are no more than kMaxVoters.
+    FMT_SLOG(WARNING, "read only requests support at most %d peers, ignored the ack from %x",
+             kMaxVoters, id);
+    return -1;
+  }
+  int s = __builtin_ctzll(~usedSlots_);
+  usedSlots_ |= uint64_t(1) << s;
+  peerSlots_[id] = s;
+  return s;
+}
 
-      readStates->emplace_back(std::move(state));
-      pendingReadIndex.erase(it);
-      readIndexQueue.pop_front();
-    }
+void ReadOnly::grow() {
+  std::vector<ReadIndexStatus> ring(ring_.size() * 2);
+  for (uint64_t seq = head_; seq < tail_; seq++) {
+    ring[seq & (ring.size() - 1)] = std::move(slot(seq));
   }
+  ring_.swap(ring);
 }
 
-}  // namespace yaraft
\ No newline at end of file
+}  // namespace yaraft
@@ -0,0 +1,161 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This benchmark measures the latency of the raft loop (Tick, Propose, GetReady,
+// Advance) on a single node while a large snapshot is being created:
+//   - idle: no snapshot is being created.
+//   - background: the snapshot is built by MemoryStorage::CreateSnapshot.
+//   - inline: the snapshot data is produced on the raft thread.
+//
+// Usage: snapshot_bench [snapshot size in MB, default 256]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "conf.h"
+#include "fluent_pb.h"
+#include "logger.h"
+#include "memory_storage.h"
+#include "raw_node.h"
+#include "ready.h"
+
+using namespace yaraft;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NoopLogger : public Logger {
+ public:
+  void Log(LogLevel level, int line, const char* file, const Slice& log) override {}
+};
+
+struct Stats {
+  std::vector<double> latencies;  // in microseconds
+
+  void Report(const char* name) {
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+      return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+    printf("%-12s iterations: %8zu  p50: %8.2fus  p99: %8.2fus  p999: %10.2fus  max: %10.2fus\n",
+           name, latencies.size(), pct(0.5), pct(0.99), pct(0.999), latencies.back());
+  }
+};
+
+class Bench {
+ public:
+  explicit Bench(size_t snapBytes) : storage_(new MemoryStorage) {
+    auto conf = new Config;
+    conf->id = 1;
+    conf->peers = {1};
+    conf->electionTick = 10;
+    conf->heartbeatTick = 1;
+    conf->storage = storage_;
+    conf->maxSizePerMsg = std::numeric_limits<uint64_t>::max();
+    conf->preVote = false;
+    node_.reset(new RawNode(conf));
+    node_->Campaign();
+    loop();
+
+    // The application state, shared immutably with the snapshot producer, so that
+    // the producer reads a point-in-time view while the raft thread keeps going.
+    image_ = std::make_shared<const std::string>(snapBytes, 'x');
+  }
+
+  // One iteration of the raft loop.
+  double loop() {
+    auto start = Clock::now();
+    node_->Tick();
+    node_->Propose(payload_);
+    std::unique_ptr<Ready> rd(node_->GetReady());
+    if (rd) {
+      rd->Advance(storage_);
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  }
+
+  void Idle(size_t iterations) {
+    Stats st;
+    for (size_t i = 0; i < iterations; i++) {
+      st.latencies.push_back(loop());
+    }
+    st.Report("idle");
+  }
+
+  void Background() {
+    Stats st;
+    auto image = image_;
+    auto start = Clock::now();
+    auto future = storage_->CreateSnapshot(node_->CommittedIndex(), pb::ConfState(),
+                                           [image]() { return produce(*image); });
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      st.latencies.push_back(loop());
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    printf("background snapshot created in %.2fms: %s\n", elapsed, future.get().ToString().c_str());
+    st.Report("background");
+  }
+
+  void Inline(size_t iterations) {
+    Stats st;
+    for (size_t i = 0; i < iterations; i++) {
+      auto start = Clock::now();
+      if (i == iterations / 2) {
+        auto snap = PBSnapshot().MetaIndex(node_->CommittedIndex()).MetaTerm(1).v;
+        snap.set_data(produce(*image_));
+        storage_->Compact(snap.metadata().index());
+      }
+      loop();
+      st.latencies.push_back(
+          std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    st.Report("inline");
+  }
+
+ private:
+  // Simulates the serialization of the state machine.
+  static std::string produce(const std::string& image) {
+    std::string data;
+    data.reserve(image.size());
+    for (size_t i = 0; i < image.size(); i += 4096) {
+      data.append(image, i, 4096);
+    }
+    return data;
+  }
+
+ private:
+  MemoryStorage* storage_;  // owned by raft
+  std::unique_ptr<RawNode> node_;
+  std::shared_ptr<const std::string> image_;
+  std::string payload_ = std::string(128, 'p');
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  SetLogger(std::unique_ptr<Logger>(new NoopLogger));
+
+  size_t mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  Bench bench(mb << 20);
+
+  bench.Idle(100000);
+  bench.Background();
+  bench.Inline(100000);
+  return 0;
+}
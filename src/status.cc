@@ -30,7 +30,11 @@ std::string Error::toString(unsigned int errorCode) {
     DUMB_ERROR_TO_STRING(LogCompacted);
     DUMB_ERROR_TO_STRING(StepLocalMsg);
     DUMB_ERROR_TO_STRING(StepPeerNotFound);
+    DUMB_ERROR_TO_STRING(SnapshotUnavailable);
     DUMB_ERROR_TO_STRING(NotLeader);
+    DUMB_ERROR_TO_STRING(SnapshotOutOfDate);
+    DUMB_ERROR_TO_STRING(ProposalDropped);
+    DUMB_ERROR_TO_STRING(NetworkError);
     default:
       FMT_LOG(FATAL, "Unknown error code: {}", code);
       return "";
@@ -0,0 +1,180 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This benchmark measures the cost per Step of the messages a leader handles
+// in steady state, where the per-peer progress lookups dominate:
+//   - MsgAppResp: an acknowledgement of the entries already matched.
+//   - MsgHeartbeatResp: a heartbeat response from an up-to-date follower.
+//   - Tick: a heartbeat broadcast to all the followers.
+//   - Replicate: a proposal committed by the MsgAppResps of all the followers,
+//     which arrive 8 proposals at a time and are stepped one by one (Step) or
+//     together (StepBatch).
+//
+// Usage: step_bench [iterations, default 1000000]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "conf.h"
+#include "fluent_pb.h"
+#include "logger.h"
+#include "memory_storage.h"
+#include "raw_node.h"
+#include "ready.h"
+
+using namespace yaraft;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NoopLogger : public Logger {
+ public:
+  void Log(LogLevel level, int line, const char* file, const Slice& log) override {}
+};
+
+class Bench {
+ public:
+  explicit Bench(uint64_t peers) : storage_(new MemoryStorage) {
+    auto conf = new Config;
+    conf->id = 1;
+    for (uint64_t id = 1; id <= peers; id++) {
+      conf->peers.push_back(id);
+    }
+    conf->electionTick = 10;
+    conf->heartbeatTick = 1;
+    conf->storage = storage_;
+    conf->maxSizePerMsg = std::numeric_limits<uint64_t>::max();
+    conf->preVote = false;
+    node_.reset(new RawNode(conf));
+
+    node_->Campaign();
+    drain();
+    for (uint64_t id = 2; id <= peers; id++) {
+      auto m = PBMessage().From(id).To(1).Term(node_->CurrentTerm()).Type(pb::MsgVoteResp).v;
+      node_->Step(m);
+    }
+    drain();
+    for (uint64_t id = 2; id <= peers; id++) {
+      followers_.push_back(id);
+      auto m = appResp(id);
+      node_->Step(m);
+    }
+    drain();
+  }
+
+  // Run returns the nanoseconds per call of `fn`.
+  template <typename Fn>
+  double Run(uint64_t iterations, Fn&& fn) {
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      fn(followers_[i % followers_.size()]);
+      if (i % 64 == 63) {
+        drain();
+      }
+    }
+    drain();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+           static_cast<double>(iterations);
+  }
+
+  // Replicate returns the nanoseconds per committed proposal.
+  double Replicate(uint64_t iterations, bool batch) {
+    const uint64_t kProposals = 8;
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; i += kProposals) {
+      std::vector<pb::Message> msgs;
+      for (uint64_t j = 0; j < kProposals; j++) {
+        node_->Propose("x");
+        drain();
+        for (uint64_t id : followers_) {
+          msgs.push_back(appResp(id));
+        }
+      }
+      if (batch) {
+        node_->StepBatch(msgs);
+      } else {
+        for (auto& m : msgs) {
+          node_->Step(m);
+        }
+      }
+      drain();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+           static_cast<double>(iterations);
+  }
+
+  pb::Message appResp(uint64_t from) {
+    return PBMessage()
+        .From(from)
+        .To(1)
+        .Term(node_->CurrentTerm())
+        .Type(pb::MsgAppResp)
+        .Index(node_->LastIndex())
+        .v;
+  }
+
+  pb::Message heartbeatResp(uint64_t from) {
+    return PBMessage().From(from).To(1).Term(node_->CurrentTerm()).Type(pb::MsgHeartbeatResp).v;
+  }
+
+  RawNode* Node() {
+    return node_.get();
+  }
+
+ private:
+  void drain() {
+    std::unique_ptr<Ready> rd(node_->GetReady());
+    if (rd) {
+      rd->Advance(storage_);
+    }
+  }
+
+ private:
+  MemoryStorage* storage_;
+  std::unique_ptr<RawNode> node_;
+  std::vector<uint64_t> followers_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  SetLogger(std::unique_ptr<Logger>(new NoopLogger));
+
+  uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  for (uint64_t peers : {3, 5, 7}) {
+    Bench b(peers);
+    double appResp = b.Run(iterations, [&](uint64_t from) {
+      auto m = b.appResp(from);
+      b.Node()->Step(m);
+    });
+    double hbResp = b.Run(iterations, [&](uint64_t from) {
+      auto m = b.heartbeatResp(from);
+      b.Node()->Step(m);
+    });
+    double tick = b.Run(iterations, [&](uint64_t) { b.Node()->Tick(); });
+    printf("peers: %llu  MsgAppResp: %8.1fns  MsgHeartbeatResp: %8.1fns  Tick: %8.1fns\n",
+           static_cast<unsigned long long>(peers), appResp, hbResp, tick);
+
+    double step = b.Replicate(iterations / 10, false);
+    double stepBatch = b.Replicate(iterations / 10, true);
+    printf("peers: %llu  Replicate: Step: %8.1fns  StepBatch: %8.1fns\n",
+           static_cast<unsigned long long>(peers), step, stepBatch);
+  }
+  return 0;
+}
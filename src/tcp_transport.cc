@@ -0,0 +1,651 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcp_transport.h"
+#include "logging.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+namespace yaraft {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t kFrameHeaderSize = 4;
+
+// frames larger than this are considered corrupted.
+const uint32_t kMaxFrameSize = 1u << 30;
+
+const int kMaxEvents = 64;
+
+Status parseAddr(const std::string& addr, sockaddr_in* sa) {
+  size_t colon = addr.rfind(':');
+  if (colon == std::string::npos) {
+    return Status::Make(Error::NetworkError, fmt::format("invalid address \"{}\"", addr));
+  }
+
+  std::string host = addr.substr(0, colon);
+  int port = std::atoi(addr.c_str() + colon + 1);
+  if (port < 0 || port > 65535) {
+    return Status::Make(Error::NetworkError, fmt::format("invalid port in \"{}\"", addr));
+  }
+
+  memset(sa, 0, sizeof(*sa));
+  sa->sin_family = AF_INET;
+  sa->sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, host.c_str(), &sa->sin_addr) != 1) {
+    return Status::Make(Error::NetworkError, fmt::format("invalid ip in \"{}\"", addr));
+  }
+  return Status::OK();
+}
+
+Status errnoStatus(const char* what) {
+  return Status::Make(Error::NetworkError, fmt::format("{}: {}", what, strerror(errno)));
+}
+
+void epollCtl(int epfd, int op, int fd, uint32_t events) {
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epfd, op, fd, &ev) != 0 && op != EPOLL_CTL_DEL) {
+    FMT_SLOG(ERROR, "epoll_ctl(%d, fd: %d) failed: %s", op, fd, strerror(errno));
+  }
+}
+
+}  // namespace
+
+struct TcpTransport::Frame {
+  // length header followed by the serialized batch.
+  std::string buf;
+  // the number of MsgSnaps in the batch.
+  int snaps;
+};
+
+struct TcpTransport::Peer {
+  uint64_t id;
+  sockaddr_in addr;
+
+  // frames queued by Send, guarded by TcpTransport::mu_.
+  std::deque<Frame> pending;
+
+  // bytes of the frames in `pending` and `sending`, bounded by maxQueueBytes.
+  std::atomic<size_t> queuedBytes;
+
+  // The fields below are only accessed by the IO thread.
+
+  // frames to be written, `offset` bytes of the front one have been written.
+  std::deque<Frame> sending;
+  size_t offset;
+
+  int fd;
+  bool connecting;
+  bool connected;
+  bool wantWrite;
+
+  Clock::time_point nextDial;
+  std::chrono::milliseconds backoff;
+};
+
+struct TcpTransport::Conn {
+  int fd;
+  std::string buf;
+};
+
+TcpTransportOptions::TcpTransportOptions()
+    : minBackoff(100),
+      maxBackoff(5000),
+      maxQueueBytes(64 << 20),
+      maxFramesPerWrite(64),
+      entryCacheSize(1024) {}
+
+TcpTransport::TcpTransport(uint64_t id, const TcpTransportOptions& options,
+                           TransportHandler* handler)
+    : id_(id),
+      options_(options),
+      handler_(handler),
+      epfd_(-1),
+      listenFd_(-1),
+      wakeFd_(-1),
+      listenPort_(0),
+      stopping_(false),
+      dials_(0),
+      encoder_(options.entryCacheSize) {}
+
+TcpTransport::~TcpTransport() {
+  Stop();
+}
+
+Status TcpTransport::Start() {
+  sockaddr_in sa;
+  Status s = parseAddr(options_.listenAddr, &sa);
+  if (!s.IsOK()) {
+    return s;
+  }
+
+  listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0) {
+    return errnoStatus("socket");
+  }
+  int on = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(listenFd_, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0) {
+    return errnoStatus("bind");
+  }
+  if (listen(listenFd_, SOMAXCONN) != 0) {
+    return errnoStatus("listen");
+  }
+  socklen_t len = sizeof(sa);
+  getsockname(listenFd_, reinterpret_cast<sockaddr*>(&sa), &len);
+  listenPort_ = ntohs(sa.sin_port);
+
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd_ < 0) {
+    return errnoStatus("epoll_create1");
+  }
+  wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeFd_ < 0) {
+    return errnoStatus("eventfd");
+  }
+  epollCtl(epfd_, EPOLL_CTL_ADD, listenFd_, EPOLLIN);
+  epollCtl(epfd_, EPOLL_CTL_ADD, wakeFd_, EPOLLIN);
+
+  FMT_SLOG(INFO, "%x transport listening on port %d", id_, listenPort_);
+  thread_ = std::thread(&TcpTransport::loop, this);
+  return Status::OK();
+}
+
+void TcpTransport::Stop() {
+  if (stopping_.exchange(true)) {
+    return;
+  }
+
+  if (thread_.joinable()) {
+    wakeup();
+    thread_.join();
+  }
+
+  for (auto& e : active_) {
+    closePeer(e.second.get());
+  }
+  active_.clear();
+  for (auto& e : inConns_) {
+    close(e.first);
+  }
+  inConns_.clear();
+  for (int fd : {listenFd_, wakeFd_, epfd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  listenFd_ = wakeFd_ = epfd_ = -1;
+}
+
+Status TcpTransport::AddPeer(uint64_t id, const std::string& addr) {
+  auto p = std::make_shared<Peer>();
+  Status s = parseAddr(addr, &p->addr);
+  if (!s.IsOK()) {
+    return s;
+  }
+  p->id = id;
+  p->queuedBytes = 0;
+  p->offset = 0;
+  p->fd = -1;
+  p->connecting = p->connected = p->wantWrite = false;
+  p->nextDial = Clock::now();
+  p->backoff = options_.minBackoff;
+
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    auto& slot = peers_[id];
+    if (slot) {
+      retired_.push_back(slot);
+    }
+    slot = p;
+  }
+  wakeup();
+  return Status::OK();
+}
+
+void TcpTransport::RemovePeer(uint64_t id) {
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    auto it = peers_.find(id);
+    if (it == peers_.end()) {
+      return;
+    }
+    retired_.push_back(it->second);
+    peers_.erase(it);
+  }
+  wakeup();
+}
+
+void TcpTransport::Send(std::vector<pb::Message>* msgs, const MsgSnapshots& snaps) {
+  std::vector<pb::MessageBatch> batches;
+  std::unordered_map<uint64_t, size_t> batchOf;
+  for (auto& m : *msgs) {
+    auto it = batchOf.find(m.to());
+    if (it == batchOf.end()) {
+      it = batchOf.emplace(m.to(), batches.size()).first;
+      batches.emplace_back();
+    }
+    batches[it->second].add_messages()->Swap(&m);
+  }
+  msgs->clear();
+  SendBatches(&batches, snaps);
+}
+
+void TcpTransport::SendBatches(std::vector<pb::MessageBatch>* batches,
+                               const MsgSnapshots& snaps) {
+  // the images may be large, they are encoded before taking the lock, and
+  // released once the frames are built.
+  MessageEncoder::EncodedSnapshots images = MessageEncoder::EncodeSnapshots(*batches, snaps);
+
+  // (peer, number of snapshots) of the dropped batches.
+  std::vector<std::pair<uint64_t, int>> dropped;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    for (auto& b : *batches) {
+      if (b.messages_size() == 0) {
+        continue;
+      }
+      uint64_t to = b.messages(0).to();
+      int nsnaps = 0;
+      for (auto& m : b.messages()) {
+        nsnaps += m.type() == pb::MsgSnap;
+      }
+
+      auto it = peers_.find(to);
+      if (it == peers_.end()) {
+        dropped.emplace_back(to, nsnaps);
+        continue;
+      }
+
+      Frame f;
+      f.snaps = nsnaps;
+      f.buf.resize(kFrameHeaderSize);
+      encoder_.AppendBatch(&b, images, &f.buf);
+
+      Peer* p = it->second.get();
+      size_t size = f.buf.size() - kFrameHeaderSize;
+      if (size > kMaxFrameSize) {
+        // the peer would drop the connection on receiving it.
+        FMT_SLOG(ERROR, "%x dropped a batch of %d bytes to peer %x, exceeding %d bytes", id_,
+                 size, to, kMaxFrameSize);
+        dropped.emplace_back(to, nsnaps);
+        continue;
+      }
+      if (p->queuedBytes.load(std::memory_order_relaxed) + f.buf.size() >
+          options_.maxQueueBytes) {
+        dropped.emplace_back(to, nsnaps);
+        continue;
+      }
+      for (size_t i = 0; i < kFrameHeaderSize; i++) {
+        f.buf[i] = static_cast<char>((size >> (i * 8)) & 0xff);
+      }
+      p->queuedBytes.fetch_add(f.buf.size(), std::memory_order_relaxed);
+      p->pending.push_back(std::move(f));
+    }
+  }
+  batches->clear();
+  wakeup();
+
+  for (auto& e : dropped) {
+    for (int i = 0; i < e.second; i++) {
+      handler_->OnSnapshotStatus(e.first, RawNode::kSnapshotFailure);
+    }
+    handler_->OnUnreachable(e.first);
+  }
+}
+
+void TcpTransport::wakeup() {
+  if (wakeFd_ < 0) {
+    return;
+  }
+  uint64_t one = 1;
+  if (write(wakeFd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    FMT_SLOG(ERROR, "%x failed to wake up transport: %s", id_, strerror(errno));
+  }
+}
+
+void TcpTransport::loop() {
+  epoll_event events[kMaxEvents];
+  while (!stopping_.load()) {
+    int n = epoll_wait(epfd_, events, kMaxEvents, epollTimeout());
+    if (n < 0 && errno != EINTR) {
+      // the remaining errors (EBADF, EFAULT, EINVAL) are bugs, and without the
+      // IO thread nothing would be sent anymore.
+      FMT_SLOG(FATAL, "%x epoll_wait failed: %s", id_, strerror(errno));
+    }
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+      uint32_t ev = events[i].events;
+      if (fd == wakeFd_) {
+        uint64_t cnt;
+        while (read(wakeFd_, &cnt, sizeof(cnt)) > 0) {
+        }
+      } else if (fd == listenFd_) {
+        acceptConns();
+      } else if (outFds_.find(fd) != outFds_.end()) {
+        Peer* p = outFds_[fd];
+        if (ev & (EPOLLERR | EPOLLHUP | EPOLLIN)) {
+          // peers never write on the connections dialed by us, so a readable
+          // connection is a closed one.
+          fail(p);
+          continue;
+        }
+        if (p->connecting) {
+          int err = 0;
+          socklen_t len = sizeof(err);
+          getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+          if (err != 0) {
+            fail(p);
+            continue;
+          }
+          p->connecting = false;
+          p->connected = true;
+          p->backoff = options_.minBackoff;
+          FMT_SLOG(INFO, "%x connected to peer %x", id_, p->id);
+        }
+        flush(p);
+      } else {
+        auto it = inConns_.find(fd);
+        if (it != inConns_.end()) {
+          readConn(it->second.get());
+        }
+      }
+    }
+
+    syncPeers();
+  }
+}
+
+void TcpTransport::syncPeers() {
+  std::vector<std::shared_ptr<Peer>> peers;
+  std::vector<std::shared_ptr<Peer>> retired;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    retired.swap(retired_);
+    for (auto& sp : retired) {
+      Peer* p = sp.get();
+      auto it = active_.find(p->id);
+      if (it != active_.end() && it->second == sp) {
+        active_.erase(it);
+      }
+      for (auto& f : p->pending) {
+        p->sending.push_back(std::move(f));
+      }
+      p->pending.clear();
+    }
+
+    for (auto& e : peers_) {
+      Peer* p = e.second.get();
+      active_[e.first] = e.second;
+      if (!p->pending.empty()) {
+        for (auto& f : p->pending) {
+          p->sending.push_back(std::move(f));
+        }
+        p->pending.clear();
+        peers.push_back(e.second);
+      }
+    }
+  }
+
+  for (auto& sp : retired) {
+    Peer* p = sp.get();
+    // close first, so that fail() doesn't start a backoff for it.
+    closePeer(p);
+    if (!p->sending.empty()) {
+      fail(p);
+    }
+  }
+
+  for (auto& sp : peers) {
+    Peer* p = sp.get();
+    if (p->connected) {
+      flush(p);
+    } else if (!p->connecting) {
+      if (Clock::now() >= p->nextDial) {
+        dial(p);
+      } else {
+        // the peer is in backoff.
+        fail(p);
+      }
+    }
+  }
+}
+
+void TcpTransport::dial(Peer* p) {
+  dials_.fetch_add(1, std::memory_order_relaxed);
+  // set before anything may fail, so that fail() starts the backoff.
+  p->connecting = true;
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    FMT_SLOG(ERROR, "%x failed to create socket: %s", id_, strerror(errno));
+    fail(p);
+    return;
+  }
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  p->fd = fd;
+  outFds_[fd] = p;
+  int ret = connect(fd, reinterpret_cast<sockaddr*>(&p->addr), sizeof(p->addr));
+  if (ret != 0 && errno != EINPROGRESS) {
+    fail(p);
+    return;
+  }
+
+  p->wantWrite = true;
+  epollCtl(epfd_, EPOLL_CTL_ADD, fd, EPOLLIN | EPOLLOUT);
+}
+
+void TcpTransport::flush(Peer* p) {
+  int maxFrames = std::min(options_.maxFramesPerWrite, IOV_MAX);
+  std::vector<iovec> iov;
+  iov.reserve(static_cast<size_t>(maxFrames));
+
+  while (!p->sending.empty()) {
+    iov.clear();
+    size_t offset = p->offset;
+    for (auto& f : p->sending) {
+      if (static_cast<int>(iov.size()) == maxFrames) {
+        break;
+      }
+      iovec v;
+      v.iov_base = const_cast<char*>(f.buf.data()) + offset;
+      v.iov_len = f.buf.size() - offset;
+      iov.push_back(v);
+      offset = 0;
+    }
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = iov.size();
+    ssize_t n = sendmsg(p->fd, &msg, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      fail(p);
+      return;
+    }
+
+    auto written = static_cast<size_t>(n);
+    while (written > 0) {
+      Frame& f = p->sending.front();
+      size_t left = f.buf.size() - p->offset;
+      if (written < left) {
+        p->offset += written;
+        break;
+      }
+      written -= left;
+      p->offset = 0;
+      for (int i = 0; i < f.snaps; i++) {
+        handler_->OnSnapshotStatus(p->id, RawNode::kSnapshotFinish);
+      }
+      p->queuedBytes.fetch_sub(f.buf.size(), std::memory_order_relaxed);
+      p->sending.pop_front();
+    }
+  }
+
+  // only wait for the socket to be writable when there's something to write.
+  bool wantWrite = !p->sending.empty();
+  if (wantWrite != p->wantWrite) {
+    p->wantWrite = wantWrite;
+    epollCtl(epfd_, EPOLL_CTL_MOD, p->fd, wantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+  }
+}
+
+void TcpTransport::fail(Peer* p) {
+  if (p->connected || p->connecting) {
+    FMT_SLOG(WARNING, "%x lost connection to peer %x, retry in %dms", id_, p->id,
+             p->backoff.count());
+    p->nextDial = Clock::now() + p->backoff;
+    p->backoff = std::min(p->backoff * 2, options_.maxBackoff);
+  }
+  closePeer(p);
+
+  for (auto& f : p->sending) {
+    for (int i = 0; i < f.snaps; i++) {
+      handler_->OnSnapshotStatus(p->id, RawNode::kSnapshotFailure);
+    }
+    p->queuedBytes.fetch_sub(f.buf.size(), std::memory_order_relaxed);
+  }
+  p->sending.clear();
+  p->offset = 0;
+  handler_->OnUnreachable(p->id);
+}
+
+void TcpTransport::closePeer(Peer* p) {
+  if (p->fd >= 0) {
+    epollCtl(epfd_, EPOLL_CTL_DEL, p->fd, 0);
+    outFds_.erase(p->fd);
+    close(p->fd);
+    p->fd = -1;
+  }
+  p->connecting = p->connected = p->wantWrite = false;
+}
+
+void TcpTransport::acceptConns() {
+  while (true) {
+    int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        FMT_SLOG(ERROR, "%x accept failed: %s", id_, strerror(errno));
+      }
+      return;
+    }
+
+    std::unique_ptr<Conn> c(new Conn);
+    c->fd = fd;
+    inConns_[fd] = std::move(c);
+    epollCtl(epfd_, EPOLL_CTL_ADD, fd, EPOLLIN);
+  }
+}
+
+void TcpTransport::readConn(Conn* c) {
+  char buf[64 * 1024];
+  bool closed = false;
+  while (true) {
+    ssize_t n = read(c->fd, buf, sizeof(buf));
+    if (n > 0) {
+      c->buf.append(buf, static_cast<size_t>(n));
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    closed = true;
+    break;
+  }
+
+  size_t pos = 0;
+  while (c->buf.size() - pos >= kFrameHeaderSize) {
+    uint32_t len = 0;
+    for (size_t i = kFrameHeaderSize; i > 0; i--) {
+      len = (len << 8) | static_cast<uint8_t>(c->buf[pos + i - 1]);
+    }
+    if (len > kMaxFrameSize) {
+      FMT_SLOG(ERROR, "%x received a corrupted frame of size %d", id_, len);
+      closed = true;
+      break;
+    }
+    if (c->buf.size() - pos - kFrameHeaderSize < len) {
+      break;
+    }
+
+    pb::MessageBatch batch;
+    if (!batch.ParseFromArray(c->buf.data() + pos + kFrameHeaderSize, static_cast<int>(len))) {
+      FMT_SLOG(ERROR, "%x failed to parse a message batch of size %d", id_, len);
+      closed = true;
+      break;
+    }
+    for (auto& m : *batch.mutable_messages()) {
+      handler_->OnMessage(std::move(m));
+    }
+    pos += kFrameHeaderSize + len;
+  }
+  c->buf.erase(0, pos);
+
+  if (closed) {
+    closeConn(c);
+  }
+}
+
+void TcpTransport::closeConn(Conn* c) {
+  int fd = c->fd;
+  epollCtl(epfd_, EPOLL_CTL_DEL, fd, 0);
+  close(fd);
+  inConns_.erase(fd);
+}
+
+int TcpTransport::epollTimeout() const {
+  // wake up in time to retry the peers in backoff.
+  auto now = Clock::now();
+  auto timeout = std::chrono::milliseconds(1000);
+  for (auto& e : active_) {
+    const Peer* p = e.second.get();
+    if (!p->connected && !p->connecting && p->nextDial > now) {
+      auto d = std::chrono::duration_cast<std::chrono::milliseconds>(p->nextDial - now);
+      timeout = std::min(timeout, d + std::chrono::milliseconds(1));
+    }
+  }
+  return static_cast<int>(timeout.count());
+}
+
+}  // namespace yaraft
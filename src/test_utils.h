@@ -37,6 +37,7 @@ Config* newTestConfig(uint64_t id, std::vector<uint64_t> peers, int election, in
   conf->peers = std::move(peers);
   conf->maxSizePerMsg = std::numeric_limits<uint64_t>::max();
   conf->preVote = false;
+  conf->checkQuorum = false;
   return conf;
 }
 
@@ -45,6 +46,13 @@ Raft* newTestRaft(uint64_t id, std::vector<uint64_t> peers, int election, int he
   return new Raft(newTestConfig(id, peers, election, heartbeat, storage));
 }
 
+Raft* newTestLearnerRaft(uint64_t id, std::vector<uint64_t> peers, std::vector<uint64_t> learners,
+                         int election, int heartbeat, Storage* storage) {
+  auto conf = newTestConfig(id, peers, election, heartbeat, storage);
+  conf->learners = std::move(learners);
+  return new Raft(conf);
+}
+
 struct Network {
   explicit Network(std::vector<Raft*> prs) {
     for (auto r : prs) {
@@ -66,7 +74,8 @@ struct Network {
 
       // Drop the message if the remote peer is dead or the connection to remote is cut down.
       uint64_t to = m.to(), from = m.from();
-      if (peers_.find(to) == peers_.end() || cutMap_[from] == to) {
+      if (peers_.find(to) == peers_.end() || cutMap_[from] == to ||
+          isolated_.find(to) != isolated_.end() || isolated_.find(from) != isolated_.end()) {
         continue;
       }
 
@@ -76,10 +85,14 @@ struct Network {
       }
 
       peers_[to]->Step(m);
+      // every message is handled in its own Ready cycle.
+      peers_[to]->flushReadIndex();
       for (auto& msg : peers_[to]->mails_) {
+        AttachSnapshot(&msg, peers_[to]->msgSnapshots_);
         msgs_.push_back(msg);
       }
       peers_[to]->mails_.clear();
+      peers_[to]->msgSnapshots_.clear();
     }
   }
 
@@ -91,8 +104,13 @@ struct Network {
     Send(PBMessage().From(id).To(id).Type(pb::MsgProp).Entries({PBEntry().Data(data).v}).v);
   }
 
-  void ReadIndex(uint64_t id, std::string ctx) {
-    Send(PBMessage().From(id).To(id).Type(pb::MsgReadIndex).Entries({PBEntry().Data(ctx).v}).v);
+  void ReadIndex(uint64_t id, uint64_t requestId) {
+    Send(PBMessage()
+             .From(id)
+             .To(id)
+             .Type(pb::MsgReadIndex)
+             .Context(new std::string(EncodeReadContext(requestId)))
+             .v);
   }
 
   static Network* New(uint64_t size) {
@@ -133,6 +151,12 @@ struct Network {
     }
   }
 
+  void SetCheckQuorum(bool checkQuorum) {
+    for (auto& p : peers_) {
+      MutablePeerConfig(p.second->id_)->checkQuorum = checkQuorum;
+    }
+  }
+
   Network* Set(Raft* r) {
     if (peers_.find(r->Id()) != peers_.end()) {
       delete peers_[r->Id()];
@@ -159,6 +183,11 @@ struct Network {
     cutMap_.erase(cutMap_.find(n2));
   }
 
+  // Cut down all the connections from and to node `id`.
+  void Isolate(uint64_t id) {
+    isolated_.insert(id);
+  }
+
   // ignore a specified type of message
   void Ignore(pb::MessageType type) {
     ignoreTypes_.insert(type);
@@ -168,6 +197,7 @@ struct Network {
   void Recover() {
     ignoreTypes_.clear();
     cutMap_.clear();
+    isolated_.clear();
   }
 
  private:
@@ -179,6 +209,8 @@ struct Network {
   std::unordered_map<uint64_t, uint64_t> cutMap_;
 
   std::set<pb::MessageType> ignoreTypes_;
+
+  std::set<uint64_t> isolated_;
 };
 
 pb::Entry pbEntry(uint64_t index, uint64_t term) {
@@ -0,0 +1,157 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transport.h"
+#include "logging.h"
+
+namespace yaraft {
+
+void Transport::SendBatches(std::vector<pb::MessageBatch>* batches, const MsgSnapshots& snaps) {
+  std::vector<pb::Message> msgs;
+  for (auto& b : *batches) {
+    for (auto& m : *b.mutable_messages()) {
+      msgs.push_back(std::move(m));
+    }
+  }
+  batches->clear();
+  Send(&msgs, snaps);
+}
+
+void RawNodeInbox::OnMessage(pb::Message msg) {
+  std::lock_guard<std::mutex> guard(mu_);
+  msgs_.push_back(std::move(msg));
+}
+
+void RawNodeInbox::OnUnreachable(uint64_t to) {
+  std::lock_guard<std::mutex> guard(mu_);
+  unreachable_.insert(to);
+}
+
+void RawNodeInbox::OnSnapshotStatus(uint64_t to, RawNode::SnapshotStatus status) {
+  std::lock_guard<std::mutex> guard(mu_);
+  snapStatuses_.emplace_back(to, status);
+}
+
+size_t RawNodeInbox::Flush(RawNode* node) {
+  std::vector<pb::Message> msgs;
+  std::unordered_set<uint64_t> unreachable;
+  std::vector<std::pair<uint64_t, RawNode::SnapshotStatus>> snapStatuses;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    msgs.swap(msgs_);
+    unreachable.swap(unreachable_);
+    snapStatuses.swap(snapStatuses_);
+  }
+
+  for (uint64_t id : unreachable) {
+    node->ReportUnreachable(id);
+  }
+  for (auto& e : snapStatuses) {
+    node->ReportSnapshot(e.first, e.second);
+  }
+  Status s = node->StepBatch(msgs);
+  if (!s.IsOK()) {
+    FMT_SLOG(WARNING, "%x failed to step some of %d messages: %s", node->Id(), msgs.size(),
+             s.ToString());
+  }
+  return msgs.size();
+}
+
+LoopbackTransport::LoopbackTransport(uint64_t id, TransportHandler* handler,
+                                     LoopbackNetwork* network)
+    : id_(id), handler_(handler), network_(network) {
+  network_->attach(this);
+}
+
+LoopbackTransport::~LoopbackTransport() {
+  network_->detach(this);
+}
+
+Status LoopbackTransport::AddPeer(uint64_t id, const std::string& /* addr */) {
+  std::lock_guard<std::mutex> guard(mu_);
+  peers_.insert(id);
+  return Status::OK();
+}
+
+void LoopbackTransport::RemovePeer(uint64_t id) {
+  std::lock_guard<std::mutex> guard(mu_);
+  peers_.erase(id);
+}
+
+void LoopbackTransport::Send(std::vector<pb::Message>* msgs, const MsgSnapshots& snaps) {
+  std::unordered_set<uint64_t> unreachable;
+  for (auto& m : *msgs) {
+    uint64_t to = m.to();
+    bool isSnap = m.type() == pb::MsgSnap;
+    bool known;
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      known = peers_.find(to) != peers_.end();
+    }
+    if (known) {
+      AttachSnapshot(&m, snaps);
+    }
+
+    bool ok = known && network_->deliver(std::move(m));
+    if (!ok) {
+      unreachable.insert(to);
+    }
+    if (isSnap) {
+      handler_->OnSnapshotStatus(to, ok ? RawNode::kSnapshotFinish : RawNode::kSnapshotFailure);
+    }
+  }
+  msgs->clear();
+
+  for (uint64_t to : unreachable) {
+    handler_->OnUnreachable(to);
+  }
+}
+
+void LoopbackNetwork::Isolate(uint64_t id) {
+  std::lock_guard<std::mutex> guard(mu_);
+  isolated_.insert(id);
+}
+
+void LoopbackNetwork::Recover() {
+  std::lock_guard<std::mutex> guard(mu_);
+  isolated_.clear();
+}
+
+void LoopbackNetwork::attach(LoopbackTransport* t) {
+  std::lock_guard<std::mutex> guard(mu_);
+  nodes_[t->Id()] = t;
+}
+
+void LoopbackNetwork::detach(LoopbackTransport* t) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto it = nodes_.find(t->Id());
+  if (it != nodes_.end() && it->second == t) {
+    nodes_.erase(it);
+  }
+}
+
+bool LoopbackNetwork::deliver(pb::Message m) {
+  // The lock is held during delivery so that the receiver can't be detached
+  // concurrently. Handlers must not send messages from OnMessage.
+  std::lock_guard<std::mutex> guard(mu_);
+  auto it = nodes_.find(m.to());
+  if (it == nodes_.end() || isolated_.find(m.to()) != isolated_.end() ||
+      isolated_.find(m.from()) != isolated_.end()) {
+    return false;
+  }
+  it->second->handler_->OnMessage(std::move(m));
+  return true;
+}
+
+}  // namespace yaraft
@@ -0,0 +1,402 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <condition_variable>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "raw_node.h"
+#include "ready.h"
+#include "tcp_transport.h"
+#include "test_utils.h"
+#include "transport.h"
+
+using namespace yaraft;
+
+class TransportTest : public BaseTest {};
+
+namespace {
+
+class RecordingHandler : public TransportHandler {
+ public:
+  void OnMessage(pb::Message msg) override {
+    std::lock_guard<std::mutex> guard(mu_);
+    msgs.push_back(std::move(msg));
+    cv_.notify_all();
+  }
+
+  void OnUnreachable(uint64_t to) override {
+    std::lock_guard<std::mutex> guard(mu_);
+    unreachable.insert(to);
+    unreachableReports++;
+    cv_.notify_all();
+  }
+
+  void OnSnapshotStatus(uint64_t to, RawNode::SnapshotStatus status) override {
+    std::lock_guard<std::mutex> guard(mu_);
+    snapStatuses.emplace_back(to, status);
+    cv_.notify_all();
+  }
+
+  // WaitFor returns whether `pred` is satisfied within 5 seconds.
+  template <typename Pred>
+  bool WaitFor(Pred pred) {
+    std::unique_lock<std::mutex> lock(mu_);
+    return cv_.wait_for(lock, std::chrono::seconds(5), pred);
+  }
+
+  std::vector<pb::Message> msgs;
+  std::unordered_set<uint64_t> unreachable;
+  int unreachableReports = 0;
+  std::vector<std::pair<uint64_t, RawNode::SnapshotStatus>> snapStatuses;
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+};
+
+// closedPort returns a local port that nobody listens on.
+uint16_t closedPort() {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  socklen_t len = sizeof(addr);
+  ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  ::close(fd);
+  return ntohs(addr.sin_port);
+}
+
+std::string localAddr(uint16_t port) {
+  return "127.0.0.1:" + std::to_string(port);
+}
+
+}  // namespace
+
+TEST_F(TransportTest, LoopbackSend) {
+  LoopbackNetwork network;
+  RecordingHandler h1, h2;
+  LoopbackTransport t1(1, &h1, &network), t2(2, &h2, &network);
+  ASSERT_OK(t1.AddPeer(2, ""));
+
+  std::vector<pb::Message> msgs;
+  for (uint64_t i = 1; i <= 3; i++) {
+    msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgApp).Index(i).v);
+  }
+  // peer 3 is not added.
+  msgs.push_back(PBMessage().From(1).To(3).Type(pb::MsgApp).v);
+  t1.Send(&msgs);
+  ASSERT_TRUE(msgs.empty());
+
+  ASSERT_EQ(h2.msgs.size(), 3);
+  for (uint64_t i = 1; i <= 3; i++) {
+    ASSERT_EQ(h2.msgs[i - 1].index(), i);
+  }
+  ASSERT_EQ(h1.unreachable, std::unordered_set<uint64_t>({3}));
+}
+
+TEST_F(TransportTest, LoopbackIsolate) {
+  LoopbackNetwork network;
+  RecordingHandler h1, h2;
+  LoopbackTransport t1(1, &h1, &network), t2(2, &h2, &network);
+  ASSERT_OK(t1.AddPeer(2, ""));
+
+  network.Isolate(2);
+  std::vector<pb::Message> msgs;
+  msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgSnap).v);
+  t1.Send(&msgs);
+  ASSERT_TRUE(h2.msgs.empty());
+  ASSERT_EQ(h1.unreachable, std::unordered_set<uint64_t>({2}));
+  ASSERT_EQ(h1.snapStatuses.size(), 1);
+  ASSERT_EQ(h1.snapStatuses[0].second, RawNode::kSnapshotFailure);
+
+  network.Recover();
+  msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgSnap).v);
+  t1.Send(&msgs);
+  ASSERT_EQ(h2.msgs.size(), 1);
+  ASSERT_EQ(h1.snapStatuses.size(), 2);
+  ASSERT_EQ(h1.snapStatuses[1].second, RawNode::kSnapshotFinish);
+}
+
+// This test ensures a raft group driven by RawNodeInbox and LoopbackTransport
+// elects a leader and replicates its log, and that the unreachable peer is
+// reported to the leader.
+TEST_F(TransportTest, LoopbackRawNodeCluster) {
+  const std::vector<uint64_t> ids = {1, 2, 3};
+
+  LoopbackNetwork network;
+  // the storages are owned by the nodes.
+  std::vector<MemoryStorage*> stores;
+  std::vector<std::unique_ptr<RawNode>> nodes;
+  std::vector<std::unique_ptr<RawNodeInbox>> inboxes;
+  std::vector<std::unique_ptr<LoopbackTransport>> transports;
+  for (uint64_t id : ids) {
+    auto memstore = new MemoryStorage();
+    stores.push_back(memstore);
+    nodes.emplace_back(new RawNode(newTestConfig(id, ids, 10, 1, memstore)));
+    inboxes.emplace_back(new RawNodeInbox);
+    transports.emplace_back(new LoopbackTransport(id, inboxes.back().get(), &network));
+    for (uint64_t peer : ids) {
+      if (peer != id) {
+        ASSERT_OK(transports.back()->AddPeer(peer, ""));
+      }
+    }
+  }
+
+  auto run = [&]() {
+    for (int round = 0; round < 10; round++) {
+      // the heartbeats from the leader resume the probing of a recovered peer.
+      nodes[0]->Tick();
+      for (size_t i = 0; i < nodes.size(); i++) {
+        inboxes[i]->Flush(nodes[i].get());
+        std::unique_ptr<Ready> rd(nodes[i]->GetReady());
+        if (rd) {
+          rd->Advance(stores[i]);
+          transports[i]->Send(&rd->messages, rd->msgSnapshots);
+        }
+      }
+    }
+  };
+
+  ASSERT_OK(nodes[0]->Campaign());
+  run();
+  for (auto& n : nodes) {
+    ASSERT_EQ(n->LeaderHint(), 1);
+  }
+
+  network.Isolate(3);
+  ASSERT_OK(nodes[0]->Propose("a"));
+  run();
+  ASSERT_EQ(nodes[0]->CommittedIndex(), 2);
+  ASSERT_EQ(nodes[1]->LastIndex(), 2);
+  ASSERT_EQ(nodes[2]->LastIndex(), 1);
+
+  network.Recover();
+  ASSERT_OK(nodes[0]->Propose("b"));
+  run();
+  for (auto& n : nodes) {
+    ASSERT_EQ(n->LastIndex(), 3);
+  }
+}
+
+TEST_F(TransportTest, TcpSend) {
+  RecordingHandler h1, h2;
+  TcpTransportOptions options;
+  options.listenAddr = "127.0.0.1:0";
+  TcpTransport t1(1, options, &h1), t2(2, options, &h2);
+  ASSERT_OK(t1.Start());
+  ASSERT_OK(t2.Start());
+  ASSERT_OK(t1.AddPeer(2, localAddr(t2.ListenPort())));
+  ASSERT_OK(t2.AddPeer(1, localAddr(t1.ListenPort())));
+
+  const uint64_t kMsgs = 1000;
+  for (uint64_t i = 1; i <= kMsgs; i++) {
+    std::vector<pb::Message> msgs;
+    msgs.push_back(PBMessage()
+                       .From(1)
+                       .To(2)
+                       .Type(pb::MsgApp)
+                       .Index(i)
+                       .Entries({PBEntry().Index(i).Term(1).Data("data").v})
+                       .v);
+    t1.Send(&msgs);
+  }
+  ASSERT_TRUE(h2.WaitFor([&]() { return h2.msgs.size() == kMsgs; }));
+  for (uint64_t i = 1; i <= kMsgs; i++) {
+    ASSERT_EQ(h2.msgs[i - 1].index(), i);
+    ASSERT_EQ(h2.msgs[i - 1].entries(0).data(), "data");
+  }
+
+  std::vector<pb::Message> msgs;
+  msgs.push_back(PBMessage().From(2).To(1).Type(pb::MsgSnap).v);
+  t2.Send(&msgs);
+  ASSERT_TRUE(h1.WaitFor([&]() { return h1.msgs.size() == 1; }));
+  ASSERT_TRUE(h2.WaitFor([&]() { return h2.snapStatuses.size() == 1; }));
+  ASSERT_EQ(h2.snapStatuses[0].second, RawNode::kSnapshotFinish);
+  ASSERT_TRUE(h1.unreachable.empty());
+  ASSERT_TRUE(h2.unreachable.empty());
+
+  t1.Stop();
+  t2.Stop();
+}
+
+// This test ensures each batch is delivered as a whole, and the snapshots in it
+// are reported once the batch is written.
+TEST_F(TransportTest, TcpSendBatches) {
+  RecordingHandler h1, h2, h3;
+  TcpTransportOptions options;
+  options.listenAddr = "127.0.0.1:0";
+  TcpTransport t1(1, options, &h1), t2(2, options, &h2), t3(3, options, &h3);
+  for (auto t : {&t1, &t2, &t3}) {
+    ASSERT_OK(t->Start());
+  }
+  ASSERT_OK(t1.AddPeer(2, localAddr(t2.ListenPort())));
+  ASSERT_OK(t1.AddPeer(3, localAddr(t3.ListenPort())));
+
+  std::vector<pb::MessageBatch> batches(2);
+  for (uint64_t i = 1; i <= 3; i++) {
+    *batches[0].add_messages() = PBMessage().From(1).To(2).Type(pb::MsgApp).Index(i).v;
+  }
+  *batches[0].add_messages() = PBMessage().From(1).To(2).Type(pb::MsgSnap).v;
+  *batches[1].add_messages() = PBMessage().From(1).To(3).Type(pb::MsgHeartbeat).v;
+  t1.SendBatches(&batches);
+  ASSERT_TRUE(batches.empty());
+
+  ASSERT_TRUE(h2.WaitFor([&]() { return h2.msgs.size() == 4; }));
+  for (uint64_t i = 1; i <= 3; i++) {
+    ASSERT_EQ(h2.msgs[i - 1].index(), i);
+  }
+  ASSERT_EQ(h2.msgs[3].type(), pb::MsgSnap);
+  ASSERT_TRUE(h3.WaitFor([&]() { return h3.msgs.size() == 1; }));
+  ASSERT_TRUE(h1.WaitFor([&]() { return h1.snapStatuses.size() == 1; }));
+  ASSERT_EQ(h1.snapStatuses[0], std::make_pair(uint64_t(2), RawNode::kSnapshotFinish));
+
+  for (auto t : {&t1, &t2, &t3}) {
+    t->Stop();
+  }
+}
+
+TEST_F(TransportTest, TcpUnreachable) {
+  RecordingHandler h1;
+  TcpTransportOptions options;
+  options.listenAddr = "127.0.0.1:0";
+  TcpTransport t1(1, options, &h1);
+  ASSERT_OK(t1.Start());
+  ASSERT_OK(t1.AddPeer(2, localAddr(closedPort())));
+
+  std::vector<pb::Message> msgs;
+  msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgApp).v);
+  msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgSnap).v);
+  // peer 3 is not added.
+  msgs.push_back(PBMessage().From(1).To(3).Type(pb::MsgApp).v);
+  t1.Send(&msgs);
+
+  ASSERT_TRUE(h1.WaitFor([&]() { return h1.unreachable.size() == 2; }));
+  ASSERT_TRUE(h1.WaitFor([&]() { return h1.snapStatuses.size() == 1; }));
+  ASSERT_EQ(h1.snapStatuses[0].second, RawNode::kSnapshotFailure);
+
+  ASSERT_FALSE(t1.AddPeer(3, "not-an-address").IsOK());
+  t1.Stop();
+}
+
+// This test ensures that a peer whose connect(2) fails immediately is retried
+// after the backoff rather than on every Send.
+TEST_F(TransportTest, TcpBackoffOnImmediateDialFailure) {
+  RecordingHandler h1;
+  TcpTransportOptions options;
+  options.listenAddr = "127.0.0.1:0";
+  options.minBackoff = std::chrono::seconds(60);
+  TcpTransport t1(1, options, &h1);
+  ASSERT_OK(t1.Start());
+  // connecting to the broadcast address fails without blocking.
+  ASSERT_OK(t1.AddPeer(2, "255.255.255.255:1"));
+
+  for (int i = 1; i <= 10; i++) {
+    std::vector<pb::Message> msgs;
+    msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgApp).v);
+    t1.Send(&msgs);
+    ASSERT_TRUE(h1.WaitFor([&]() { return h1.unreachableReports == i; }));
+  }
+  ASSERT_EQ(t1.TEST_Dials(), 1);
+  t1.Stop();
+}
+
+// This test ensures that the frames written to a peer that doesn't read count
+// towards maxQueueBytes, so the queue is bounded once the socket is full.
+TEST_F(TransportTest, TcpMaxQueueBytesWithSlowPeer) {
+  // a peer that accepts the connection but never reads.
+  int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  ASSERT_EQ(::listen(lfd, 1), 0);
+  socklen_t len = sizeof(addr);
+  ::getsockname(lfd, reinterpret_cast<sockaddr*>(&addr), &len);
+
+  RecordingHandler h1;
+  TcpTransportOptions options;
+  options.listenAddr = "127.0.0.1:0";
+  options.maxQueueBytes = 1 << 20;
+  TcpTransport t1(1, options, &h1);
+  ASSERT_OK(t1.Start());
+  ASSERT_OK(t1.AddPeer(2, localAddr(ntohs(addr.sin_port))));
+
+  const std::string data(64 << 10, 'x');
+  // far more than the socket buffers hold.
+  for (int i = 0; i < 512; i++) {
+    std::vector<pb::Message> msgs;
+    msgs.push_back(PBMessage()
+                       .From(1)
+                       .To(2)
+                       .Type(pb::MsgApp)
+                       .Entries({PBEntry().Index(1).Term(1).Data(data).v})
+                       .v);
+    t1.Send(&msgs);
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  ASSERT_TRUE(h1.WaitFor([&]() { return h1.unreachable.count(2) == 1; }));
+  ASSERT_EQ(t1.TEST_Dials(), 1);
+
+  t1.Stop();
+  ::close(lfd);
+}
+
+// This test ensures that removing a peer fails the messages still queued for
+// it, so that a MsgSnap among them is reported as failed.
+TEST_F(TransportTest, TcpRemovePeerFailsQueuedSnapshot) {
+  // a peer that accepts the connection but never reads.
+  int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  ASSERT_EQ(::listen(lfd, 1), 0);
+  socklen_t len = sizeof(addr);
+  ::getsockname(lfd, reinterpret_cast<sockaddr*>(&addr), &len);
+
+  RecordingHandler h1;
+  TcpTransportOptions options;
+  options.listenAddr = "127.0.0.1:0";
+  TcpTransport t1(1, options, &h1);
+  ASSERT_OK(t1.Start());
+  ASSERT_OK(t1.AddPeer(2, localAddr(ntohs(addr.sin_port))));
+
+  // far more than the socket buffers hold, so the MsgSnap stays queued.
+  const std::string data(64 << 10, 'x');
+  for (uint64_t i = 1; i <= 512; i++) {
+    std::vector<pb::Message> msgs;
+    msgs.push_back(PBMessage()
+                       .From(1)
+                       .To(2)
+                       .Type(pb::MsgApp)
+                       .Entries({PBEntry().Index(i).Term(1).Data(data).v})
+                       .v);
+    t1.Send(&msgs);
+  }
+  std::vector<pb::Message> msgs;
+  msgs.push_back(PBMessage().From(1).To(2).Type(pb::MsgSnap).v);
+  t1.Send(&msgs);
+
+  t1.RemovePeer(2);
+  ASSERT_TRUE(h1.WaitFor([&]() { return h1.snapStatuses.size() == 1; }));
+  ASSERT_EQ(h1.snapStatuses[0].second, RawNode::kSnapshotFailure);
+
+  t1.Stop();
+  ::close(lfd);
+}
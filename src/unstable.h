@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 
 #include "fluent_pb.h"
@@ -54,11 +56,14 @@ struct Unstable {
   // Required: after <= offset + entries.size, in other words, there's no hole between two entries.
   void TruncateAndAppend(EntriesIterator begin, EntriesIterator end) {
     uint64_t after = begin->index();
+    confIndexes.erase(std::lower_bound(confIndexes.begin(), confIndexes.end(), after),
+                      confIndexes.end());
     if (after == offset + entries.size()) {
       // after is the next index in the u.entries directly append
       entries.reserve(entries.size() + std::distance(begin, end));
       std::for_each(begin, end, [&](pb::Entry& e) { entries.push_back(std::move(e)); });
     } else if (after <= offset) {
+      sizes.clear();
       FMT_SLOG(INFO, "replace the unstable entries from index %d", after);
       // The log is being truncated to before our current offset
       // portion, so set the offset and replace the entries
@@ -70,40 +75,86 @@ struct Unstable {
     } else {
       // offset < after < offset + entries.size
       FMT_SLOG(INFO, "truncate the unstable entries before index %d", after);
+      sizes.resize(std::min(sizes.size(), after - offset));
       entries.resize(after - offset + std::distance(begin, end));
       for (int i = after - offset; i < entries.size(); i++) {
         entries[i].Swap(&(*begin++));
       }
     }
+    syncSizes();
+
+    for (size_t i = after - offset; i < entries.size(); i++) {
+      if (entries[i].type() == pb::EntryConfChange) {
+        confIndexes.push_back(entries[i].index());
+      }
+    }
+  }
+
+  // ConfChanges returns the number of the EntryConfChange entries whose index
+  // is not less than lo.
+  size_t ConfChanges(uint64_t lo) const {
+    if (confIndexesStale) {
+      confIndexes.clear();
+      for (auto& e : entries) {
+        if (e.type() == pb::EntryConfChange) {
+          confIndexes.push_back(e.index());
+        }
+      }
+      confIndexesStale = false;
+    }
+    return confIndexes.end() - std::lower_bound(confIndexes.begin(), confIndexes.end(), lo);
   }
 
   // REQUIRED: all existing log entries are conflicted with the snapshot.
   void Restore(pb::Snapshot& snap) {
     offset = snap.metadata().index() + 1;
     entries.clear();
-    snapshot.reset(new pb::Snapshot);
-    snapshot->Swap(&snap);
+    sizes.clear();
+    confIndexes.clear();
+    auto s = new pb::Snapshot;
+    s->Swap(&snap);
+    snapshot.reset(s);
+  }
+
+  // StableAll hands all the unstable entries over to `out`, to be persisted by
+  // the application, and moves the offset past them.
+  void StableAll(EntryVec* out) {
+    offset += entries.size();
+    *out = std::move(entries);
+    entries.clear();
+    sizes.clear();
+    confIndexes.clear();
+    confIndexesStale = false;
   }
 
   void CopyTo(EntryVec& vec, uint64_t lo, uint64_t hi, uint64_t maxSize) {
+    ForEach(lo, hi, maxSize, [&](const pb::Entry& e) { vec.push_back(e); });
+  }
+
+  // ForEach calls `fn` on the entries that CopyTo would copy.
+  template <typename Fn>
+  void ForEach(uint64_t lo, uint64_t hi, uint64_t maxSize, Fn&& fn) const {
     MustCheckOutOfBounds(lo, hi);
 
-    auto begin = lo - offset + entries.begin();
-    auto end = entries.end();
-    if (hi - offset < entries.size()) {
-      end = entries.begin() + hi - offset;
+    syncSizes();
+    uint64_t loOffset = lo - offset;
+    uint64_t hiOffset = hi - offset;
+    uint64_t base = loOffset == 0 ? 0 : sizes[loOffset - 1];
+    if (maxSize <= std::numeric_limits<uint64_t>::max() - base) {
+      hiOffset = std::upper_bound(sizes.begin() + loOffset, sizes.begin() + hiOffset,
+                                  base + maxSize) -
+                 sizes.begin();
     }
 
-    uint64_t size = 0;
-    auto it = begin;
-    for (; it != end; it++) {
-      size += it->ByteSize();
-      if (size > maxSize)
-        break;
-    }
-    end = it;
+    std::for_each(entries.begin() + loOffset, entries.begin() + hiOffset, fn);
+  }
 
-    std::copy(begin, end, std::back_inserter(vec));
+  // syncSizes computes the sizes of the entries that `sizes` doesn't cover
+  // yet, see `sizes`.
+  void syncSizes() const {
+    for (size_t i = sizes.size(); i < entries.size(); i++) {
+      sizes.push_back((i == 0 ? 0 : sizes[i - 1]) + entries[i].ByteSize());
+    }
   }
 
   // u.offset <= lo <= hi <= u.offset+len(u.offset)
@@ -118,14 +169,34 @@ struct Unstable {
     }
   }
 
+  /// The following functions are for test only.
+
+  std::vector<pb::Entry>& TEST_Entries() {
+    // the entries may be changed by the caller.
+    sizes.clear();
+    confIndexesStale = true;
+    return entries;
+  }
+
  public:
   size_t offset;
 
   // all entries that have not yet been written to storage.
   std::vector<pb::Entry> entries;
 
+  // sizes[i] is the total encoded size of entries[0..i], computed once when
+  // the entries are appended, so that the cut point of maxSize is binary
+  // searched. It covers a prefix of entries; it must be cleared when entries
+  // is changed other than by the methods above, see TEST_Entries.
+  mutable std::vector<uint64_t> sizes;
+
+  // the indexes of the EntryConfChange entries, in order. They are rebuilt if
+  // confIndexesStale is set.
+  mutable std::vector<uint64_t> confIndexes;
+  mutable bool confIndexesStale{false};
+
   // the incoming unstable snapshot, if any.
-  std::unique_ptr<pb::Snapshot> snapshot;
+  SnapshotSptr snapshot;
 };
 
 }  // namespace yaraft
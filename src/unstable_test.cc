@@ -78,7 +78,7 @@ TEST_F(UnstableTest, TruncateAndAppend) {
 
   for (auto t : tests) {
     Unstable u;
-    u.entries = t.entries;
+    u.TEST_Entries() = t.entries;
     u.offset = t.offset;
     u.snapshot.reset(t.snap);
 
@@ -92,7 +92,7 @@ TEST_F(UnstableTest, TruncateAndAppend) {
 
 TEST_F(UnstableTest, Restore) {
   Unstable u;
-  u.entries = {PBEntry().Index(5).Term(1).v};
+  u.TEST_Entries() = {PBEntry().Index(5).Term(1).v};
   u.offset = 6;
 
   auto snap = PBSnapshot().MetaIndex(4).MetaTerm(1).v;
@@ -164,7 +164,7 @@ TEST_F(UnstableTest, MaybeTerm) {
   for (auto t : tests) {
     Unstable u;
     u.offset = t.offset;
-    u.entries = t.entries;
+    u.TEST_Entries() = t.entries;
     u.snapshot.reset(t.snap);
 
     ASSERT_EQ(u.MaybeTerm(t.index), t.wterm);
@@ -199,11 +199,56 @@ TEST_F(UnstableTest, CopyTo) {
 
   for (auto t : tests) {
     Unstable u;
-    u.entries = {pbEntry(1, 1)};
-    std::copy(t.ents.begin(), t.ents.end(), std::back_inserter(u.entries));
+    u.TEST_Entries() = {pbEntry(1, 1)};
+    std::copy(t.ents.begin(), t.ents.end(), std::back_inserter(u.TEST_Entries()));
     u.offset = 1;
 
     EntryVec result;
     u.CopyTo(result, t.lo, t.hi, static_cast<uint64_t>(t.maxSize));
   }
-}
\ No newline at end of file
+}
+// This test ensures the size limit of CopyTo follows the entries replaced by
+// TruncateAndAppend.
+TEST_F(UnstableTest, CopyToAfterTruncate) {
+  Unstable u;
+  u.offset = 1;
+  auto msg = PBMessage().Entries({pbEntry(1, 1), pbEntry(2, 1), pbEntry(3, 1)}).v;
+  u.TruncateAndAppend(msg.mutable_entries()->begin(), msg.mutable_entries()->end());
+
+  auto large = PBEntry().Index(2).Term(2).Data(std::string(100, 'x')).v;
+  msg = PBMessage().Entries({large, PBEntry().Index(3).Term(2).v}).v;
+  u.TruncateAndAppend(msg.mutable_entries()->begin(), msg.mutable_entries()->end());
+
+  EntryVec result;
+  u.CopyTo(result, 1, 4, pbEntry(1, 1).ByteSize() + large.ByteSize());
+  EntryVec_ASSERT_EQ(result, EntryVec({pbEntry(1, 1), large}));
+
+  result.clear();
+  u.CopyTo(result, 2, 4, large.ByteSize() - 1);
+  ASSERT_TRUE(result.empty());
+}
+
+// This test ensures ConfChanges follows the entries replaced by
+// TruncateAndAppend, and the ones set by TEST_Entries.
+TEST_F(UnstableTest, ConfChanges) {
+  auto cc = [](uint64_t index, uint64_t term) {
+    return PBEntry().Index(index).Term(term).Type(pb::EntryConfChange).v;
+  };
+
+  Unstable u;
+  u.offset = 1;
+  auto msg = PBMessage().Entries({cc(1, 1), pbEntry(2, 1), cc(3, 1)}).v;
+  u.TruncateAndAppend(msg.mutable_entries()->begin(), msg.mutable_entries()->end());
+  ASSERT_EQ(u.ConfChanges(1), 2);
+  ASSERT_EQ(u.ConfChanges(2), 1);
+  ASSERT_EQ(u.ConfChanges(4), 0);
+
+  msg = PBMessage().Entries({pbEntry(3, 2), cc(4, 2)}).v;
+  u.TruncateAndAppend(msg.mutable_entries()->begin(), msg.mutable_entries()->end());
+  ASSERT_EQ(u.ConfChanges(2), 1);
+  ASSERT_EQ(u.ConfChanges(4), 1);
+
+  u.TEST_Entries() = {pbEntry(1, 1), cc(2, 1)};
+  ASSERT_EQ(u.ConfChanges(1), 1);
+  ASSERT_EQ(u.ConfChanges(3), 0);
+}
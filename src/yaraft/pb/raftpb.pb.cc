@@ -42,6 +42,9 @@ const ::google::protobuf::internal::GeneratedMessageReflection*
 const ::google::protobuf::Descriptor* ConfChange_descriptor_ = NULL;
 const ::google::protobuf::internal::GeneratedMessageReflection*
   ConfChange_reflection_ = NULL;
+const ::google::protobuf::Descriptor* MessageBatch_descriptor_ = NULL;
+const ::google::protobuf::internal::GeneratedMessageReflection*
+  MessageBatch_reflection_ = NULL;
 const ::google::protobuf::EnumDescriptor* EntryType_descriptor_ = NULL;
 const ::google::protobuf::EnumDescriptor* MessageType_descriptor_ = NULL;
 const ::google::protobuf::EnumDescriptor* ConfChangeType_descriptor_ = NULL;
@@ -150,8 +153,10 @@ void protobuf_AssignDesc_yaraft_2fpb_2fraftpb_2eproto() {
       ::google::protobuf::MessageFactory::generated_factory(),
       sizeof(HardState));
   ConfState_descriptor_ = file->message_type(5);
-  static const int ConfState_offsets_[1] = {
+  static const int ConfState_offsets_[3] = {
     GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfState, nodes_),
+    GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfState, learners_),
+    GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfState, nodes_outgoing_),
   };
   ConfState_reflection_ =
     new ::google::protobuf::internal::GeneratedMessageReflection(
@@ -165,11 +170,12 @@ void protobuf_AssignDesc_yaraft_2fpb_2fraftpb_2eproto() {
       ::google::protobuf::MessageFactory::generated_factory(),
       sizeof(ConfState));
   ConfChange_descriptor_ = file->message_type(6);
-  static const int ConfChange_offsets_[4] = {
+  static const int ConfChange_offsets_[5] = {
     GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfChange, id_),
     GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfChange, type_),
     GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfChange, nodeid_),
     GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfChange, context_),
+    GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(ConfChange, voters_),
   };
   ConfChange_reflection_ =
     new ::google::protobuf::internal::GeneratedMessageReflection(
@@ -182,6 +188,21 @@ void protobuf_AssignDesc_yaraft_2fpb_2fraftpb_2eproto() {
       ::google::protobuf::DescriptorPool::generated_pool(),
       ::google::protobuf::MessageFactory::generated_factory(),
       sizeof(ConfChange));
+  MessageBatch_descriptor_ = file->message_type(7);
+  static const int MessageBatch_offsets_[1] = {
+    GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(MessageBatch, messages_),
+  };
+  MessageBatch_reflection_ =
+    new ::google::protobuf::internal::GeneratedMessageReflection(
+      MessageBatch_descriptor_,
+      MessageBatch::default_instance_,
+      MessageBatch_offsets_,
+      GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(MessageBatch, _has_bits_[0]),
+      GOOGLE_PROTOBUF_GENERATED_MESSAGE_FIELD_OFFSET(MessageBatch, _unknown_fields_),
+      -1,
+      ::google::protobuf::DescriptorPool::generated_pool(),
+      ::google::protobuf::MessageFactory::generated_factory(),
+      sizeof(MessageBatch));
   EntryType_descriptor_ = file->enum_type(0);
   MessageType_descriptor_ = file->enum_type(1);
   ConfChangeType_descriptor_ = file->enum_type(2);
@@ -211,6 +232,8 @@ void protobuf_RegisterTypes(const ::std::string&) {
     ConfState_descriptor_, &ConfState::default_instance());
   ::google::protobuf::MessageFactory::InternalRegisterGeneratedMessage(
     ConfChange_descriptor_, &ConfChange::default_instance());
+  ::google::protobuf::MessageFactory::InternalRegisterGeneratedMessage(
+    MessageBatch_descriptor_, &MessageBatch::default_instance());
 }
 
 }  // namespace
@@ -230,6 +253,8 @@ void protobuf_ShutdownFile_yaraft_2fpb_2fraftpb_2eproto() {
   delete ConfState_reflection_;
   delete ConfChange::default_instance_;
   delete ConfChange_reflection_;
+  delete MessageBatch::default_instance_;
+  delete MessageBatch_reflection_;
 }
 
 void protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto() {
@@ -254,22 +279,27 @@ void protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto() {
     ".yaraft.pb.Snapshot\022\016\n\006reject\030\n \001(\010\022\022\n\nr"
     "ejectHint\030\013 \001(\004\022\017\n\007context\030\014 \001(\014\"7\n\tHard"
     "State\022\014\n\004term\030\001 \001(\004\022\014\n\004vote\030\002 \001(\004\022\016\n\006com"
-    "mit\030\003 \001(\004\"\032\n\tConfState\022\r\n\005nodes\030\001 \003(\004\"b\n"
-    "\nConfChange\022\n\n\002ID\030\001 \001(\004\022\'\n\004Type\030\002 \001(\0162\031."
-    "yaraft.pb.ConfChangeType\022\016\n\006NodeID\030\003 \001(\004"
-    "\022\017\n\007Context\030\004 \001(\014*1\n\tEntryType\022\017\n\013EntryN"
-    "ormal\020\000\022\023\n\017EntryConfChange\020\001*\323\002\n\013Message"
-    "Type\022\n\n\006MsgHup\020\000\022\013\n\007MsgBeat\020\001\022\013\n\007MsgProp"
-    "\020\002\022\n\n\006MsgApp\020\003\022\016\n\nMsgAppResp\020\004\022\013\n\007MsgVot"
-    "e\020\005\022\017\n\013MsgVoteResp\020\006\022\013\n\007MsgSnap\020\007\022\020\n\014Msg"
-    "Heartbeat\020\010\022\024\n\020MsgHeartbeatResp\020\t\022\022\n\016Msg"
-    "Unreachable\020\n\022\021\n\rMsgSnapStatus\020\013\022\022\n\016MsgC"
-    "heckQuorum\020\014\022\025\n\021MsgTransferLeader\020\r\022\021\n\rM"
-    "sgTimeoutNow\020\016\022\020\n\014MsgReadIndex\020\017\022\024\n\020MsgR"
-    "eadIndexResp\020\020\022\016\n\nMsgPreVote\020\021\022\022\n\016MsgPre"
-    "VoteResp\020\022*[\n\016ConfChangeType\022\025\n\021ConfChan"
-    "geAddNode\020\000\022\030\n\024ConfChangeRemoveNode\020\001\022\030\n"
-    "\024ConfChangeUpdateNode\020\002", 1223);
+    "mit\030\003 \001(\004\"D\n\tConfState\022\r\n\005nodes\030\001 \003(\004\022\020\n"
+    "\010learners\030\002 \003(\004\022\026\n\016nodes_outgoing\030\003 \003(\004\""
+    "r\n\nConfChange\022\n\n\002ID\030\001 \001(\004\022\'\n\004Type\030\002 \001(\0162"
+    "\031.yaraft.pb.ConfChangeType\022\016\n\006NodeID\030\003 \001"
+    "(\004\022\017\n\007Context\030\004 \001(\014\022\016\n\006Voters\030\005 \003(\004\"4\n\014M"
+    "essageBatch\022$\n\010messages\030\001 \003(\0132\022.yaraft.p"
+    "b.Message*1\n\tEntryType\022\017\n\013EntryNormal\020\000\022"
+    "\023\n\017EntryConfChange\020\001*\323\002\n\013MessageType\022\n\n\006"
+    "MsgHup\020\000\022\013\n\007MsgBeat\020\001\022\013\n\007MsgProp\020\002\022\n\n\006Ms"
+    "gApp\020\003\022\016\n\nMsgAppResp\020\004\022\013\n\007MsgVote\020\005\022\017\n\013M"
+    "sgVoteResp\020\006\022\013\n\007MsgSnap\020\007\022\020\n\014MsgHeartbea"
+    "t\020\010\022\024\n\020MsgHeartbeatResp\020\t\022\022\n\016MsgUnreacha"
+    "ble\020\n\022\021\n\rMsgSnapStatus\020\013\022\022\n\016MsgCheckQuor"
+    "um\020\014\022\025\n\021MsgTransferLeader\020\r\022\021\n\rMsgTimeou"
+    "tNow\020\016\022\020\n\014MsgReadIndex\020\017\022\024\n\020MsgReadIndex"
+    "Resp\020\020\022\016\n\nMsgPreVote\020\021\022\022\n\016MsgPreVoteResp"
+    "\020\022*\255\001\n\016ConfChangeType\022\025\n\021ConfChangeAddNo"
+    "de\020\000\022\030\n\024ConfChangeRemoveNode\020\001\022\030\n\024ConfCh"
+    "angeUpdateNode\020\002\022\034\n\030ConfChangeAddLearner"
+    "Node\020\003\022\030\n\024ConfChangeBeginJoint\020\004\022\030\n\024Conf"
+    "ChangeLeaveJoint\020\005", 1418);
   ::google::protobuf::MessageFactory::InternalRegisterGeneratedFile(
     "yaraft/pb/raftpb.proto", &protobuf_RegisterTypes);
   Entry::default_instance_ = new Entry();
@@ -279,6 +309,7 @@ void protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto() {
   HardState::default_instance_ = new HardState();
   ConfState::default_instance_ = new ConfState();
   ConfChange::default_instance_ = new ConfChange();
+  MessageBatch::default_instance_ = new MessageBatch();
   Entry::default_instance_->InitAsDefaultInstance();
   SnapshotMetadata::default_instance_->InitAsDefaultInstance();
   Snapshot::default_instance_->InitAsDefaultInstance();
@@ -286,6 +317,7 @@ void protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto() {
   HardState::default_instance_->InitAsDefaultInstance();
   ConfState::default_instance_->InitAsDefaultInstance();
   ConfChange::default_instance_->InitAsDefaultInstance();
+  MessageBatch::default_instance_->InitAsDefaultInstance();
   ::google::protobuf::internal::OnShutdown(&protobuf_ShutdownFile_yaraft_2fpb_2fraftpb_2eproto);
 }
 
@@ -349,6 +381,9 @@ bool ConfChangeType_IsValid(int value) {
     case 0:
     case 1:
     case 2:
+    case 3:
+    case 4:
+    case 5:
       return true;
     default:
       return false;
@@ -2325,6 +2360,8 @@ void HardState::Swap(HardState* other) {
 
 #ifndef _MSC_VER
 const int ConfState::kNodesFieldNumber;
+const int ConfState::kLearnersFieldNumber;
+const int ConfState::kNodesOutgoingFieldNumber;
 #endif  // !_MSC_VER
 
 ConfState::ConfState()
@@ -2381,6 +2418,8 @@ ConfState* ConfState::New() const {
 
 void ConfState::Clear() {
   nodes_.Clear();
+  learners_.Clear();
+  nodes_outgoing_.Clear();
   ::memset(_has_bits_, 0, sizeof(_has_bits_));
   mutable_unknown_fields()->Clear();
 }
@@ -2410,6 +2449,44 @@ bool ConfState::MergePartialFromCodedStream(
           goto handle_unusual;
         }
         if (input->ExpectTag(8)) goto parse_nodes;
+        if (input->ExpectTag(16)) goto parse_learners;
+        break;
+      }
+
+      // repeated uint64 learners = 2;
+      case 2: {
+        if (tag == 16) {
+         parse_learners:
+          DO_((::google::protobuf::internal::WireFormatLite::ReadRepeatedPrimitive<
+                   ::google::protobuf::uint64, ::google::protobuf::internal::WireFormatLite::TYPE_UINT64>(
+                 1, 16, input, this->mutable_learners())));
+        } else if (tag == 18) {
+          DO_((::google::protobuf::internal::WireFormatLite::ReadPackedPrimitiveNoInline<
+                   ::google::protobuf::uint64, ::google::protobuf::internal::WireFormatLite::TYPE_UINT64>(
+                 input, this->mutable_learners())));
+        } else {
+          goto handle_unusual;
+        }
+        if (input->ExpectTag(16)) goto parse_learners;
+        if (input->ExpectTag(24)) goto parse_nodes_outgoing;
+        break;
+      }
+
+      // repeated uint64 nodes_outgoing = 3;
+      case 3: {
+        if (tag == 24) {
+         parse_nodes_outgoing:
+          DO_((::google::protobuf::internal::WireFormatLite::ReadRepeatedPrimitive<
+                   ::google::protobuf::uint64, ::google::protobuf::internal::WireFormatLite::TYPE_UINT64>(
+                 1, 24, input, this->mutable_nodes_outgoing())));
+        } else if (tag == 26) {
+          DO_((::google::protobuf::internal::WireFormatLite::ReadPackedPrimitiveNoInline<
+                   ::google::protobuf::uint64, ::google::protobuf::internal::WireFormatLite::TYPE_UINT64>(
+                 input, this->mutable_nodes_outgoing())));
+        } else {
+          goto handle_unusual;
+        }
+        if (input->ExpectTag(24)) goto parse_nodes_outgoing;
         if (input->ExpectAtEnd()) goto success;
         break;
       }
@@ -2445,6 +2522,18 @@ void ConfState::SerializeWithCachedSizes(
       1, this->nodes(i), output);
   }
 
+  // repeated uint64 learners = 2;
+  for (int i = 0; i < this->learners_size(); i++) {
+    ::google::protobuf::internal::WireFormatLite::WriteUInt64(
+      2, this->learners(i), output);
+  }
+
+  // repeated uint64 nodes_outgoing = 3;
+  for (int i = 0; i < this->nodes_outgoing_size(); i++) {
+    ::google::protobuf::internal::WireFormatLite::WriteUInt64(
+      3, this->nodes_outgoing(i), output);
+  }
+
   if (!unknown_fields().empty()) {
     ::google::protobuf::internal::WireFormat::SerializeUnknownFields(
         unknown_fields(), output);
@@ -2461,6 +2550,18 @@ void ConfState::SerializeWithCachedSizes(
       WriteUInt64ToArray(1, this->nodes(i), target);
   }
 
+  // repeated uint64 learners = 2;
+  for (int i = 0; i < this->learners_size(); i++) {
+    target = ::google::protobuf::internal::WireFormatLite::
+      WriteUInt64ToArray(2, this->learners(i), target);
+  }
+
+  // repeated uint64 nodes_outgoing = 3;
+  for (int i = 0; i < this->nodes_outgoing_size(); i++) {
+    target = ::google::protobuf::internal::WireFormatLite::
+      WriteUInt64ToArray(3, this->nodes_outgoing(i), target);
+  }
+
   if (!unknown_fields().empty()) {
     target = ::google::protobuf::internal::WireFormat::SerializeUnknownFieldsToArray(
         unknown_fields(), target);
@@ -2482,6 +2583,26 @@ int ConfState::ByteSize() const {
     total_size += 1 * this->nodes_size() + data_size;
   }
 
+  // repeated uint64 learners = 2;
+  {
+    int data_size = 0;
+    for (int i = 0; i < this->learners_size(); i++) {
+      data_size += ::google::protobuf::internal::WireFormatLite::
+        UInt64Size(this->learners(i));
+    }
+    total_size += 1 * this->learners_size() + data_size;
+  }
+
+  // repeated uint64 nodes_outgoing = 3;
+  {
+    int data_size = 0;
+    for (int i = 0; i < this->nodes_outgoing_size(); i++) {
+      data_size += ::google::protobuf::internal::WireFormatLite::
+        UInt64Size(this->nodes_outgoing(i));
+    }
+    total_size += 1 * this->nodes_outgoing_size() + data_size;
+  }
+
   if (!unknown_fields().empty()) {
     total_size +=
       ::google::protobuf::internal::WireFormat::ComputeUnknownFieldsSize(
@@ -2508,6 +2629,8 @@ void ConfState::MergeFrom(const ::google::protobuf::Message& from) {
 void ConfState::MergeFrom(const ConfState& from) {
   GOOGLE_CHECK_NE(&from, this);
   nodes_.MergeFrom(from.nodes_);
+  learners_.MergeFrom(from.learners_);
+  nodes_outgoing_.MergeFrom(from.nodes_outgoing_);
   mutable_unknown_fields()->MergeFrom(from.unknown_fields());
 }
 
@@ -2531,6 +2654,8 @@ bool ConfState::IsInitialized() const {
 void ConfState::Swap(ConfState* other) {
   if (other != this) {
     nodes_.Swap(&other->nodes_);
+    learners_.Swap(&other->learners_);
+    nodes_outgoing_.Swap(&other->nodes_outgoing_);
     std::swap(_has_bits_[0], other->_has_bits_[0]);
     _unknown_fields_.Swap(&other->_unknown_fields_);
     std::swap(_cached_size_, other->_cached_size_);
@@ -2553,6 +2678,7 @@ const int ConfChange::kIDFieldNumber;
 const int ConfChange::kTypeFieldNumber;
 const int ConfChange::kNodeIDFieldNumber;
 const int ConfChange::kContextFieldNumber;
+const int ConfChange::kVotersFieldNumber;
 #endif  // !_MSC_VER
 
 ConfChange::ConfChange()
@@ -2639,6 +2765,7 @@ void ConfChange::Clear() {
 #undef OFFSET_OF_FIELD_
 #undef ZR_
 
+  voters_.Clear();
   ::memset(_has_bits_, 0, sizeof(_has_bits_));
   mutable_unknown_fields()->Clear();
 }
@@ -2711,6 +2838,25 @@ bool ConfChange::MergePartialFromCodedStream(
         } else {
           goto handle_unusual;
         }
+        if (input->ExpectTag(40)) goto parse_Voters;
+        break;
+      }
+
+      // repeated uint64 Voters = 5;
+      case 5: {
+        if (tag == 40) {
+         parse_Voters:
+          DO_((::google::protobuf::internal::WireFormatLite::ReadRepeatedPrimitive<
+                   ::google::protobuf::uint64, ::google::protobuf::internal::WireFormatLite::TYPE_UINT64>(
+                 1, 40, input, this->mutable_voters())));
+        } else if (tag == 42) {
+          DO_((::google::protobuf::internal::WireFormatLite::ReadPackedPrimitiveNoInline<
+                   ::google::protobuf::uint64, ::google::protobuf::internal::WireFormatLite::TYPE_UINT64>(
+                 input, this->mutable_voters())));
+        } else {
+          goto handle_unusual;
+        }
+        if (input->ExpectTag(40)) goto parse_Voters;
         if (input->ExpectAtEnd()) goto success;
         break;
       }
@@ -2762,6 +2908,12 @@ void ConfChange::SerializeWithCachedSizes(
       4, this->context(), output);
   }
 
+  // repeated uint64 Voters = 5;
+  for (int i = 0; i < this->voters_size(); i++) {
+    ::google::protobuf::internal::WireFormatLite::WriteUInt64(
+      5, this->voters(i), output);
+  }
+
   if (!unknown_fields().empty()) {
     ::google::protobuf::internal::WireFormat::SerializeUnknownFields(
         unknown_fields(), output);
@@ -2795,6 +2947,12 @@ void ConfChange::SerializeWithCachedSizes(
         4, this->context(), target);
   }
 
+  // repeated uint64 Voters = 5;
+  for (int i = 0; i < this->voters_size(); i++) {
+    target = ::google::protobuf::internal::WireFormatLite::
+      WriteUInt64ToArray(5, this->voters(i), target);
+  }
+
   if (!unknown_fields().empty()) {
     target = ::google::protobuf::internal::WireFormat::SerializeUnknownFieldsToArray(
         unknown_fields(), target);
@@ -2835,6 +2993,16 @@ int ConfChange::ByteSize() const {
     }
 
   }
+  // repeated uint64 Voters = 5;
+  {
+    int data_size = 0;
+    for (int i = 0; i < this->voters_size(); i++) {
+      data_size += ::google::protobuf::internal::WireFormatLite::
+        UInt64Size(this->voters(i));
+    }
+    total_size += 1 * this->voters_size() + data_size;
+  }
+
   if (!unknown_fields().empty()) {
     total_size +=
       ::google::protobuf::internal::WireFormat::ComputeUnknownFieldsSize(
@@ -2860,6 +3028,7 @@ void ConfChange::MergeFrom(const ::google::protobuf::Message& from) {
 
 void ConfChange::MergeFrom(const ConfChange& from) {
   GOOGLE_CHECK_NE(&from, this);
+  voters_.MergeFrom(from.voters_);
   if (from._has_bits_[0 / 32] & (0xffu << (0 % 32))) {
     if (from.has_id()) {
       set_id(from.id());
@@ -2900,6 +3069,7 @@ void ConfChange::Swap(ConfChange* other) {
     std::swap(type_, other->type_);
     std::swap(nodeid_, other->nodeid_);
     std::swap(context_, other->context_);
+    voters_.Swap(&other->voters_);
     std::swap(_has_bits_[0], other->_has_bits_[0]);
     _unknown_fields_.Swap(&other->_unknown_fields_);
     std::swap(_cached_size_, other->_cached_size_);
@@ -2915,6 +3085,225 @@ void ConfChange::Swap(ConfChange* other) {
 }
 
 
+// ===================================================================
+
+#ifndef _MSC_VER
+const int MessageBatch::kMessagesFieldNumber;
+#endif  // !_MSC_VER
+
+MessageBatch::MessageBatch()
+  : ::google::protobuf::Message() {
+  SharedCtor();
+  // @@protoc_insertion_point(constructor:yaraft.pb.MessageBatch)
+}
+
+void MessageBatch::InitAsDefaultInstance() {
+}
+
+MessageBatch::MessageBatch(const MessageBatch& from)
+  : ::google::protobuf::Message() {
+  SharedCtor();
+  MergeFrom(from);
+  // @@protoc_insertion_point(copy_constructor:yaraft.pb.MessageBatch)
+}
+
+void MessageBatch::SharedCtor() {
+  _cached_size_ = 0;
+  ::memset(_has_bits_, 0, sizeof(_has_bits_));
+}
+
+MessageBatch::~MessageBatch() {
+  // @@protoc_insertion_point(destructor:yaraft.pb.MessageBatch)
+  SharedDtor();
+}
+
+void MessageBatch::SharedDtor() {
+  if (this != default_instance_) {
+  }
+}
+
+void MessageBatch::SetCachedSize(int size) const {
+  GOOGLE_SAFE_CONCURRENT_WRITES_BEGIN();
+  _cached_size_ = size;
+  GOOGLE_SAFE_CONCURRENT_WRITES_END();
+}
+const ::google::protobuf::Descriptor* MessageBatch::descriptor() {
+  protobuf_AssignDescriptorsOnce();
+  return MessageBatch_descriptor_;
+}
+
+const MessageBatch& MessageBatch::default_instance() {
+  if (default_instance_ == NULL) protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto();
+  return *default_instance_;
+}
+
+MessageBatch* MessageBatch::default_instance_ = NULL;
+
+MessageBatch* MessageBatch::New() const {
+  return new MessageBatch;
+}
+
+void MessageBatch::Clear() {
+  messages_.Clear();
+  ::memset(_has_bits_, 0, sizeof(_has_bits_));
+  mutable_unknown_fields()->Clear();
+}
+
+bool MessageBatch::MergePartialFromCodedStream(
+    ::google::protobuf::io::CodedInputStream* input) {
+#define DO_(EXPRESSION) if (!(EXPRESSION)) goto failure
+  ::google::protobuf::uint32 tag;
+  // @@protoc_insertion_point(parse_start:yaraft.pb.MessageBatch)
+  for (;;) {
+    ::std::pair< ::google::protobuf::uint32, bool> p = input->ReadTagWithCutoff(127);
+    tag = p.first;
+    if (!p.second) goto handle_unusual;
+    switch (::google::protobuf::internal::WireFormatLite::GetTagFieldNumber(tag)) {
+      // repeated .yaraft.pb.Message messages = 1;
+      case 1: {
+        if (tag == 10) {
+         parse_messages:
+          DO_(::google::protobuf::internal::WireFormatLite::ReadMessageNoVirtual(
+                input, add_messages()));
+        } else {
+          goto handle_unusual;
+        }
+        if (input->ExpectTag(10)) goto parse_messages;
+        if (input->ExpectAtEnd()) goto success;
+        break;
+      }
+
+      default: {
+      handle_unusual:
+        if (tag == 0 ||
+            ::google::protobuf::internal::WireFormatLite::GetTagWireType(tag) ==
+            ::google::protobuf::internal::WireFormatLite::WIRETYPE_END_GROUP) {
+          goto success;
+        }
+        DO_(::google::protobuf::internal::WireFormat::SkipField(
+              input, tag, mutable_unknown_fields()));
+        break;
+      }
+    }
+  }
+success:
+  // @@protoc_insertion_point(parse_success:yaraft.pb.MessageBatch)
+  return true;
+failure:
+  // @@protoc_insertion_point(parse_failure:yaraft.pb.MessageBatch)
+  return false;
+#undef DO_
+}
+
+void MessageBatch::SerializeWithCachedSizes(
+    ::google::protobuf::io::CodedOutputStream* output) const {
+  // @@protoc_insertion_point(serialize_start:yaraft.pb.MessageBatch)
+  // repeated .yaraft.pb.Message messages = 1;
+  for (int i = 0; i < this->messages_size(); i++) {
+    ::google::protobuf::internal::WireFormatLite::WriteMessageMaybeToArray(
+      1, this->messages(i), output);
+  }
+
+  if (!unknown_fields().empty()) {
+    ::google::protobuf::internal::WireFormat::SerializeUnknownFields(
+        unknown_fields(), output);
+  }
+  // @@protoc_insertion_point(serialize_end:yaraft.pb.MessageBatch)
+}
+
+::google::protobuf::uint8* MessageBatch::SerializeWithCachedSizesToArray(
+    ::google::protobuf::uint8* target) const {
+  // @@protoc_insertion_point(serialize_to_array_start:yaraft.pb.MessageBatch)
+  // repeated .yaraft.pb.Message messages = 1;
+  for (int i = 0; i < this->messages_size(); i++) {
+    target = ::google::protobuf::internal::WireFormatLite::
+      WriteMessageNoVirtualToArray(
+        1, this->messages(i), target);
+  }
+
+  if (!unknown_fields().empty()) {
+    target = ::google::protobuf::internal::WireFormat::SerializeUnknownFieldsToArray(
+        unknown_fields(), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:yaraft.pb.MessageBatch)
+  return target;
+}
+
+int MessageBatch::ByteSize() const {
+  int total_size = 0;
+
+  // repeated .yaraft.pb.Message messages = 1;
+  total_size += 1 * this->messages_size();
+  for (int i = 0; i < this->messages_size(); i++) {
+    total_size +=
+      ::google::protobuf::internal::WireFormatLite::MessageSizeNoVirtual(
+        this->messages(i));
+  }
+
+  if (!unknown_fields().empty()) {
+    total_size +=
+      ::google::protobuf::internal::WireFormat::ComputeUnknownFieldsSize(
+        unknown_fields());
+  }
+  GOOGLE_SAFE_CONCURRENT_WRITES_BEGIN();
+  _cached_size_ = total_size;
+  GOOGLE_SAFE_CONCURRENT_WRITES_END();
+  return total_size;
+}
+
+void MessageBatch::MergeFrom(const ::google::protobuf::Message& from) {
+  GOOGLE_CHECK_NE(&from, this);
+  const MessageBatch* source =
+    ::google::protobuf::internal::dynamic_cast_if_available<const MessageBatch*>(
+      &from);
+  if (source == NULL) {
+    ::google::protobuf::internal::ReflectionOps::Merge(from, this);
+  } else {
+    MergeFrom(*source);
+  }
+}
+
+void MessageBatch::MergeFrom(const MessageBatch& from) {
+  GOOGLE_CHECK_NE(&from, this);
+  messages_.MergeFrom(from.messages_);
+  mutable_unknown_fields()->MergeFrom(from.unknown_fields());
+}
+
+void MessageBatch::CopyFrom(const ::google::protobuf::Message& from) {
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+void MessageBatch::CopyFrom(const MessageBatch& from) {
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool MessageBatch::IsInitialized() const {
+
+  return true;
+}
+
+void MessageBatch::Swap(MessageBatch* other) {
+  if (other != this) {
+    messages_.Swap(&other->messages_);
+    std::swap(_has_bits_[0], other->_has_bits_[0]);
+    _unknown_fields_.Swap(&other->_unknown_fields_);
+    std::swap(_cached_size_, other->_cached_size_);
+  }
+}
+
+::google::protobuf::Metadata MessageBatch::GetMetadata() const {
+  protobuf_AssignDescriptorsOnce();
+  ::google::protobuf::Metadata metadata;
+  metadata.descriptor = MessageBatch_descriptor_;
+  metadata.reflection = MessageBatch_reflection_;
+  return metadata;
+}
+
+
 // @@protoc_insertion_point(namespace_scope)
 
 }  // namespace pb
@@ -42,6 +42,7 @@ class Message;
 class HardState;
 class ConfState;
 class ConfChange;
+class MessageBatch;
 
 enum EntryType {
   EntryNormal = 0,
@@ -101,11 +102,14 @@ inline bool MessageType_Parse(
 enum ConfChangeType {
   ConfChangeAddNode = 0,
   ConfChangeRemoveNode = 1,
-  ConfChangeUpdateNode = 2
+  ConfChangeUpdateNode = 2,
+  ConfChangeAddLearnerNode = 3,
+  ConfChangeBeginJoint = 4,
+  ConfChangeLeaveJoint = 5
 };
 bool ConfChangeType_IsValid(int value);
 const ConfChangeType ConfChangeType_MIN = ConfChangeAddNode;
-const ConfChangeType ConfChangeType_MAX = ConfChangeUpdateNode;
+const ConfChangeType ConfChangeType_MAX = ConfChangeLeaveJoint;
 const int ConfChangeType_ARRAYSIZE = ConfChangeType_MAX + 1;
 
 const ::google::protobuf::EnumDescriptor* ConfChangeType_descriptor();
@@ -794,6 +798,30 @@ class ConfState : public ::google::protobuf::Message {
   inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
       mutable_nodes();
 
+  // repeated uint64 learners = 2;
+  inline int learners_size() const;
+  inline void clear_learners();
+  static const int kLearnersFieldNumber = 2;
+  inline ::google::protobuf::uint64 learners(int index) const;
+  inline void set_learners(int index, ::google::protobuf::uint64 value);
+  inline void add_learners(::google::protobuf::uint64 value);
+  inline const ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >&
+      learners() const;
+  inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
+      mutable_learners();
+
+  // repeated uint64 nodes_outgoing = 3;
+  inline int nodes_outgoing_size() const;
+  inline void clear_nodes_outgoing();
+  static const int kNodesOutgoingFieldNumber = 3;
+  inline ::google::protobuf::uint64 nodes_outgoing(int index) const;
+  inline void set_nodes_outgoing(int index, ::google::protobuf::uint64 value);
+  inline void add_nodes_outgoing(::google::protobuf::uint64 value);
+  inline const ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >&
+      nodes_outgoing() const;
+  inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
+      mutable_nodes_outgoing();
+
   // @@protoc_insertion_point(class_scope:yaraft.pb.ConfState)
  private:
 
@@ -802,6 +830,8 @@ class ConfState : public ::google::protobuf::Message {
   ::google::protobuf::uint32 _has_bits_[1];
   mutable int _cached_size_;
   ::google::protobuf::RepeatedField< ::google::protobuf::uint64 > nodes_;
+  ::google::protobuf::RepeatedField< ::google::protobuf::uint64 > learners_;
+  ::google::protobuf::RepeatedField< ::google::protobuf::uint64 > nodes_outgoing_;
   friend void  protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto();
   friend void protobuf_AssignDesc_yaraft_2fpb_2fraftpb_2eproto();
   friend void protobuf_ShutdownFile_yaraft_2fpb_2fraftpb_2eproto();
@@ -897,6 +927,18 @@ class ConfChange : public ::google::protobuf::Message {
   inline ::std::string* release_context();
   inline void set_allocated_context(::std::string* context);
 
+  // repeated uint64 Voters = 5;
+  inline int voters_size() const;
+  inline void clear_voters();
+  static const int kVotersFieldNumber = 5;
+  inline ::google::protobuf::uint64 voters(int index) const;
+  inline void set_voters(int index, ::google::protobuf::uint64 value);
+  inline void add_voters(::google::protobuf::uint64 value);
+  inline const ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >&
+      voters() const;
+  inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
+      mutable_voters();
+
   // @@protoc_insertion_point(class_scope:yaraft.pb.ConfChange)
  private:
   inline void set_has_id();
@@ -915,6 +957,7 @@ class ConfChange : public ::google::protobuf::Message {
   ::google::protobuf::uint64 id_;
   ::google::protobuf::uint64 nodeid_;
   ::std::string* context_;
+  ::google::protobuf::RepeatedField< ::google::protobuf::uint64 > voters_;
   int type_;
   friend void  protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto();
   friend void protobuf_AssignDesc_yaraft_2fpb_2fraftpb_2eproto();
@@ -923,6 +966,88 @@ class ConfChange : public ::google::protobuf::Message {
   void InitAsDefaultInstance();
   static ConfChange* default_instance_;
 };
+// -------------------------------------------------------------------
+
+class MessageBatch : public ::google::protobuf::Message {
+ public:
+  MessageBatch();
+  virtual ~MessageBatch();
+
+  MessageBatch(const MessageBatch& from);
+
+  inline MessageBatch& operator=(const MessageBatch& from) {
+    CopyFrom(from);
+    return *this;
+  }
+
+  inline const ::google::protobuf::UnknownFieldSet& unknown_fields() const {
+    return _unknown_fields_;
+  }
+
+  inline ::google::protobuf::UnknownFieldSet* mutable_unknown_fields() {
+    return &_unknown_fields_;
+  }
+
+  static const ::google::protobuf::Descriptor* descriptor();
+  static const MessageBatch& default_instance();
+
+  void Swap(MessageBatch* other);
+
+  // implements Message ----------------------------------------------
+
+  MessageBatch* New() const;
+  void CopyFrom(const ::google::protobuf::Message& from);
+  void MergeFrom(const ::google::protobuf::Message& from);
+  void CopyFrom(const MessageBatch& from);
+  void MergeFrom(const MessageBatch& from);
+  void Clear();
+  bool IsInitialized() const;
+
+  int ByteSize() const;
+  bool MergePartialFromCodedStream(
+      ::google::protobuf::io::CodedInputStream* input);
+  void SerializeWithCachedSizes(
+      ::google::protobuf::io::CodedOutputStream* output) const;
+  ::google::protobuf::uint8* SerializeWithCachedSizesToArray(::google::protobuf::uint8* output) const;
+  int GetCachedSize() const { return _cached_size_; }
+  private:
+  void SharedCtor();
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  public:
+  ::google::protobuf::Metadata GetMetadata() const;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+  // repeated .yaraft.pb.Message messages = 1;
+  inline int messages_size() const;
+  inline void clear_messages();
+  static const int kMessagesFieldNumber = 1;
+  inline const ::yaraft::pb::Message& messages(int index) const;
+  inline ::yaraft::pb::Message* mutable_messages(int index);
+  inline ::yaraft::pb::Message* add_messages();
+  inline const ::google::protobuf::RepeatedPtrField< ::yaraft::pb::Message >&
+      messages() const;
+  inline ::google::protobuf::RepeatedPtrField< ::yaraft::pb::Message >*
+      mutable_messages();
+
+  // @@protoc_insertion_point(class_scope:yaraft.pb.MessageBatch)
+ private:
+
+  ::google::protobuf::UnknownFieldSet _unknown_fields_;
+
+  ::google::protobuf::uint32 _has_bits_[1];
+  mutable int _cached_size_;
+  ::google::protobuf::RepeatedPtrField< ::yaraft::pb::Message > messages_;
+  friend void  protobuf_AddDesc_yaraft_2fpb_2fraftpb_2eproto();
+  friend void protobuf_AssignDesc_yaraft_2fpb_2fraftpb_2eproto();
+  friend void protobuf_ShutdownFile_yaraft_2fpb_2fraftpb_2eproto();
+
+  void InitAsDefaultInstance();
+  static MessageBatch* default_instance_;
+};
 // ===================================================================
 
 
@@ -1771,6 +1896,66 @@ ConfState::mutable_nodes() {
   return &nodes_;
 }
 
+// repeated uint64 learners = 2;
+inline int ConfState::learners_size() const {
+  return learners_.size();
+}
+inline void ConfState::clear_learners() {
+  learners_.Clear();
+}
+inline ::google::protobuf::uint64 ConfState::learners(int index) const {
+  // @@protoc_insertion_point(field_get:yaraft.pb.ConfState.learners)
+  return learners_.Get(index);
+}
+inline void ConfState::set_learners(int index, ::google::protobuf::uint64 value) {
+  learners_.Set(index, value);
+  // @@protoc_insertion_point(field_set:yaraft.pb.ConfState.learners)
+}
+inline void ConfState::add_learners(::google::protobuf::uint64 value) {
+  learners_.Add(value);
+  // @@protoc_insertion_point(field_add:yaraft.pb.ConfState.learners)
+}
+inline const ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >&
+ConfState::learners() const {
+  // @@protoc_insertion_point(field_list:yaraft.pb.ConfState.learners)
+  return learners_;
+}
+inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
+ConfState::mutable_learners() {
+  // @@protoc_insertion_point(field_mutable_list:yaraft.pb.ConfState.learners)
+  return &learners_;
+}
+
+// repeated uint64 nodes_outgoing = 3;
+inline int ConfState::nodes_outgoing_size() const {
+  return nodes_outgoing_.size();
+}
+inline void ConfState::clear_nodes_outgoing() {
+  nodes_outgoing_.Clear();
+}
+inline ::google::protobuf::uint64 ConfState::nodes_outgoing(int index) const {
+  // @@protoc_insertion_point(field_get:yaraft.pb.ConfState.nodes_outgoing)
+  return nodes_outgoing_.Get(index);
+}
+inline void ConfState::set_nodes_outgoing(int index, ::google::protobuf::uint64 value) {
+  nodes_outgoing_.Set(index, value);
+  // @@protoc_insertion_point(field_set:yaraft.pb.ConfState.nodes_outgoing)
+}
+inline void ConfState::add_nodes_outgoing(::google::protobuf::uint64 value) {
+  nodes_outgoing_.Add(value);
+  // @@protoc_insertion_point(field_add:yaraft.pb.ConfState.nodes_outgoing)
+}
+inline const ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >&
+ConfState::nodes_outgoing() const {
+  // @@protoc_insertion_point(field_list:yaraft.pb.ConfState.nodes_outgoing)
+  return nodes_outgoing_;
+}
+inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
+ConfState::mutable_nodes_outgoing() {
+  // @@protoc_insertion_point(field_mutable_list:yaraft.pb.ConfState.nodes_outgoing)
+  return &nodes_outgoing_;
+}
+
 // -------------------------------------------------------------------
 
 // ConfChange
@@ -1924,6 +2109,70 @@ inline void ConfChange::set_allocated_context(::std::string* context) {
   // @@protoc_insertion_point(field_set_allocated:yaraft.pb.ConfChange.Context)
 }
 
+// repeated uint64 Voters = 5;
+inline int ConfChange::voters_size() const {
+  return voters_.size();
+}
+inline void ConfChange::clear_voters() {
+  voters_.Clear();
+}
+inline ::google::protobuf::uint64 ConfChange::voters(int index) const {
+  // @@protoc_insertion_point(field_get:yaraft.pb.ConfChange.Voters)
+  return voters_.Get(index);
+}
+inline void ConfChange::set_voters(int index, ::google::protobuf::uint64 value) {
+  voters_.Set(index, value);
+  // @@protoc_insertion_point(field_set:yaraft.pb.ConfChange.Voters)
+}
+inline void ConfChange::add_voters(::google::protobuf::uint64 value) {
+  voters_.Add(value);
+  // @@protoc_insertion_point(field_add:yaraft.pb.ConfChange.Voters)
+}
+inline const ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >&
+ConfChange::voters() const {
+  // @@protoc_insertion_point(field_list:yaraft.pb.ConfChange.Voters)
+  return voters_;
+}
+inline ::google::protobuf::RepeatedField< ::google::protobuf::uint64 >*
+ConfChange::mutable_voters() {
+  // @@protoc_insertion_point(field_mutable_list:yaraft.pb.ConfChange.Voters)
+  return &voters_;
+}
+
+// -------------------------------------------------------------------
+
+// MessageBatch
+
+// repeated .yaraft.pb.Message messages = 1;
+inline int MessageBatch::messages_size() const {
+  return messages_.size();
+}
+inline void MessageBatch::clear_messages() {
+  messages_.Clear();
+}
+inline const ::yaraft::pb::Message& MessageBatch::messages(int index) const {
+  // @@protoc_insertion_point(field_get:yaraft.pb.MessageBatch.messages)
+  return messages_.Get(index);
+}
+inline ::yaraft::pb::Message* MessageBatch::mutable_messages(int index) {
+  // @@protoc_insertion_point(field_mutable:yaraft.pb.MessageBatch.messages)
+  return messages_.Mutable(index);
+}
+inline ::yaraft::pb::Message* MessageBatch::add_messages() {
+  // @@protoc_insertion_point(field_add:yaraft.pb.MessageBatch.messages)
+  return messages_.Add();
+}
+inline const ::google::protobuf::RepeatedPtrField< ::yaraft::pb::Message >&
+MessageBatch::messages() const {
+  // @@protoc_insertion_point(field_list:yaraft.pb.MessageBatch.messages)
+  return messages_;
+}
+inline ::google::protobuf::RepeatedPtrField< ::yaraft::pb::Message >*
+MessageBatch::mutable_messages() {
+  // @@protoc_insertion_point(field_mutable_list:yaraft.pb.MessageBatch.messages)
+  return &messages_;
+}
+
 
 // @@protoc_insertion_point(namespace_scope)
 